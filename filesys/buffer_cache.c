@@ -0,0 +1,323 @@
+/* buffer_cache.c: Cache of file system disk sectors.
+ *
+ * Every sector the inode layer reads or writes goes through a small cache
+ * of sector-sized buffers, so that the partial-sector writes of small
+ * writes and the repeated reads of directory lookups hit memory instead of
+ * the disk.  Writes only dirty the cached copy; the flusher writes dirty
+ * sectors back periodically, and buffer_cache_flush () writes all of them
+ * at shutdown.  Entries are replaced by the clock algorithm.  Sectors a
+ * sequential reader is about to need are read ahead by a worker thread.
+ *
+ * cache_lock protects which sector each entry holds and the clock hand.
+ * Each entry has a lock of its own that protects its contents, so that
+ * accesses to different sectors copy in and out in parallel.  While a
+ * thread holds an entry's lock, the entry keeps its sector.  A thread
+ * holding the cache lock never waits for an entry's lock, only tries it,
+ * so that a thread holding an entry's lock may wait for the cache lock. */
+
+#include "filesys/buffer_cache.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Ticks between two runs of the flusher. */
+#define FLUSH_INTERVAL TIMER_FREQ
+
+/* Sectors waiting to be read ahead.  Requests beyond this are dropped. */
+#define RA_QUEUE 64
+
+/* Marks an entry that holds no sector. */
+#define SECTOR_NONE ((disk_sector_t) -1)
+
+/* A cached sector. */
+struct buffer {
+	disk_sector_t sector;       /* Sector held, or SECTOR_NONE. */
+	bool dirty;                 /* Changed since it was last written? */
+	bool accessed;              /* Used since the clock hand passed? */
+	struct lock lock;           /* Protects the contents. */
+	uint8_t data[DISK_SECTOR_SIZE]; /* Contents of the sector. */
+};
+
+size_t buffer_cache_size = 64;
+struct buffer_cache_stats buffer_cache_stats;
+
+static struct buffer *buffers;  /* BUFFER_CACHE_SIZE entries. */
+static size_t clock_hand;       /* Next entry the clock looks at. */
+static struct lock cache_lock;
+
+/* Ring of sectors to read ahead, protected by ra_lock. */
+static disk_sector_t ra_queue[RA_QUEUE];
+static size_t ra_head, ra_cnt;
+static struct lock ra_lock;
+static struct condition ra_ready;
+
+static void flusher (void *aux);
+static void reader (void *aux);
+
+/* Initializes the buffer cache and starts the flusher.  Leaves the cache
+ * disabled if it cannot be allocated. */
+void
+buffer_cache_init (void) {
+	size_t i;
+
+	lock_init (&cache_lock);
+	lock_init (&ra_lock);
+	cond_init (&ra_ready);
+	if (buffer_cache_size == 0)
+		return;
+	buffers = calloc (buffer_cache_size, sizeof *buffers);
+	if (buffers == NULL) {
+		printf ("buffer cache: out of memory, caching disabled\n");
+		buffer_cache_size = 0;
+		return;
+	}
+	for (i = 0; i < buffer_cache_size; i++) {
+		buffers[i].sector = SECTOR_NONE;
+		lock_init (&buffers[i].lock);
+	}
+	thread_create ("bc_flusher", PRI_DEFAULT, flusher, NULL);
+	thread_create ("bc_reader", PRI_DEFAULT, reader, NULL);
+}
+
+/* Writes B back if it is dirty.  B's lock must be held. */
+static void
+buffer_write_back (struct buffer *b) {
+	ASSERT (lock_held_by_current_thread (&b->lock));
+
+	if (b->dirty) {
+		disk_write (filesys_disk, b->sector, b->data);
+		b->dirty = false;
+		buffer_cache_stats.written++;
+	}
+}
+
+/* Returns the entry holding SECTOR, or NULL.  cache_lock must be held. */
+static struct buffer *
+buffer_lookup (disk_sector_t sector) {
+	size_t i;
+
+	for (i = 0; i < buffer_cache_size; i++)
+		if (buffers[i].sector == sector)
+			return &buffers[i];
+	return NULL;
+}
+
+/* Picks an entry to replace by the clock algorithm and returns it with its
+ * lock held.  Entries another thread is using are passed over.  Returns
+ * NULL if every entry was in use for two sweeps of the clock.  cache_lock
+ * must be held. */
+static struct buffer *
+buffer_evict (void) {
+	size_t i;
+
+	for (i = 0; i < 2 * buffer_cache_size; i++) {
+		struct buffer *b = &buffers[clock_hand];
+
+		clock_hand = (clock_hand + 1) % buffer_cache_size;
+		if (b->accessed)
+			b->accessed = false;
+		else if (lock_try_acquire (&b->lock))
+			return b;
+	}
+	return NULL;
+}
+
+/* Returns the entry for SECTOR with its lock held, filling an entry if
+ * none holds it yet.  Unless FILL is false, a new entry's contents are read
+ * from the disk. */
+static struct buffer *
+buffer_get (disk_sector_t sector, bool fill) {
+	for (;;) {
+		struct buffer *b;
+
+		lock_acquire (&cache_lock);
+		b = buffer_lookup (sector);
+		if (b == NULL) {
+			b = buffer_evict ();
+			if (b == NULL) {
+				/* Every entry is in use.  Sleep rather than yield, so that
+				 * their holders get to run whatever their priority. */
+				lock_release (&cache_lock);
+				timer_sleep (1);
+				continue;
+			}
+			if (b->dirty) {
+				/* Write the old sector back without cache_lock.  Lookups of
+				 * it still find the entry and wait for its lock, so that
+				 * nobody reads it back from the disk before it gets there. */
+				lock_release (&cache_lock);
+				buffer_write_back (b);
+				lock_acquire (&cache_lock);
+				if (buffer_lookup (sector) != NULL) {
+					/* Another thread cached SECTOR meanwhile. */
+					b->sector = SECTOR_NONE;
+					lock_release (&cache_lock);
+					lock_release (&b->lock);
+					continue;
+				}
+			}
+			b->sector = sector;
+			b->accessed = true;
+			lock_release (&cache_lock);
+
+			/* Whoever looks the sector up meanwhile waits for the lock. */
+			if (fill)
+				disk_read (filesys_disk, sector, b->data);
+			buffer_cache_stats.misses++;
+			return b;
+		}
+		lock_release (&cache_lock);
+
+		/* The entry may be given to another sector before we get it. */
+		lock_acquire (&b->lock);
+		if (b->sector == sector) {
+			b->accessed = true;
+			buffer_cache_stats.hits++;
+			return b;
+		}
+		lock_release (&b->lock);
+	}
+}
+
+/* Reads SIZE bytes from OFS within SECTOR of the file system disk into
+ * BUFFER. */
+void
+buffer_cache_read (disk_sector_t sector, void *buffer, int ofs, int size) {
+	struct buffer *b;
+
+	ASSERT (ofs >= 0 && size >= 0 && ofs + size <= DISK_SECTOR_SIZE);
+
+	if (buffer_cache_size == 0) {
+		uint8_t *bounce;
+
+		if (ofs == 0 && size == DISK_SECTOR_SIZE) {
+			disk_read (filesys_disk, sector, buffer);
+			return;
+		}
+		bounce = malloc (DISK_SECTOR_SIZE);
+		if (bounce == NULL)
+			PANIC ("buffer cache: out of memory");
+		disk_read (filesys_disk, sector, bounce);
+		memcpy (buffer, bounce + ofs, size);
+		free (bounce);
+		return;
+	}
+
+	b = buffer_get (sector, true);
+	memcpy (buffer, b->data + ofs, size);
+	lock_release (&b->lock);
+}
+
+/* Writes SIZE bytes from BUFFER to OFS within SECTOR of the file system
+ * disk.  The sector reaches the disk later, when the flusher runs or the
+ * entry is replaced. */
+void
+buffer_cache_write (disk_sector_t sector, const void *buffer, int ofs,
+		int size) {
+	struct buffer *b;
+
+	ASSERT (ofs >= 0 && size >= 0 && ofs + size <= DISK_SECTOR_SIZE);
+
+	if (buffer_cache_size == 0) {
+		uint8_t *bounce;
+
+		if (ofs == 0 && size == DISK_SECTOR_SIZE) {
+			disk_write (filesys_disk, sector, buffer);
+			return;
+		}
+		bounce = malloc (DISK_SECTOR_SIZE);
+		if (bounce == NULL)
+			PANIC ("buffer cache: out of memory");
+		disk_read (filesys_disk, sector, bounce);
+		memcpy (bounce + ofs, buffer, size);
+		disk_write (filesys_disk, sector, bounce);
+		free (bounce);
+		return;
+	}
+
+	/* A whole sector need not be read first. */
+	b = buffer_get (sector, ofs != 0 || size != DISK_SECTOR_SIZE);
+	memcpy (b->data + ofs, buffer, size);
+	b->dirty = true;
+	lock_release (&b->lock);
+}
+
+/* Has SECTOR read into the cache in the background.  A thread that needs
+ * the sector before it arrives waits only for that sector. */
+void
+buffer_cache_readahead (disk_sector_t sector) {
+	if (buffer_cache_size == 0)
+		return;
+
+	lock_acquire (&ra_lock);
+	if (ra_cnt < RA_QUEUE) {
+		ra_queue[(ra_head + ra_cnt++) % RA_QUEUE] = sector;
+		cond_signal (&ra_ready, &ra_lock);
+	}
+	lock_release (&ra_lock);
+}
+
+/* Writes every dirty sector in the cache to the disk. */
+void
+buffer_cache_flush (void) {
+	size_t i;
+
+	for (i = 0; i < buffer_cache_size; i++) {
+		struct buffer *b = &buffers[i];
+
+		lock_acquire (&b->lock);
+		if (b->sector != SECTOR_NONE)
+			buffer_write_back (b);
+		lock_release (&b->lock);
+	}
+}
+
+/* Prints buffer cache statistics. */
+void
+buffer_cache_print_stats (void) {
+	printf ("Buffer cache: %llu hits, %llu misses, %llu sectors written, "
+			"%llu read ahead\n",
+			buffer_cache_stats.hits, buffer_cache_stats.misses,
+			buffer_cache_stats.written, buffer_cache_stats.prefetched);
+}
+
+/* The flusher.  Writes dirty sectors back every FLUSH_INTERVAL ticks, so
+ * that data written reaches the disk in bounded time. */
+static void
+flusher (void *aux UNUSED) {
+	for (;;) {
+		timer_sleep (FLUSH_INTERVAL);
+		buffer_cache_flush ();
+	}
+}
+
+/* The read-ahead worker.  Reads the queued sectors that are not cached
+ * yet, oldest request first. */
+static void
+reader (void *aux UNUSED) {
+	for (;;) {
+		disk_sector_t sector;
+		bool cached;
+
+		lock_acquire (&ra_lock);
+		while (ra_cnt == 0)
+			cond_wait (&ra_ready, &ra_lock);
+		sector = ra_queue[ra_head];
+		ra_head = (ra_head + 1) % RA_QUEUE;
+		ra_cnt--;
+		lock_release (&ra_lock);
+
+		lock_acquire (&cache_lock);
+		cached = buffer_lookup (sector) != NULL;
+		lock_release (&cache_lock);
+		if (!cached) {
+			lock_release (&buffer_get (sector, true)->lock);
+			buffer_cache_stats.prefetched++;
+		}
+	}
+}
@@ -0,0 +1,173 @@
+/* dentry.c: Cache of directory lookups.
+ *
+ * Maps a directory's inode sector and a name in it to the inode sector of
+ * the file by that name, or to DENTRY_NONE if there is none, so that
+ * opening the same path again does not search the directory again.  The
+ * cache holds at most DENTRY_MAX entries and drops the least recently
+ * used one to make room.  dir_add () and dir_remove () invalidate the
+ * entry for the name they change.  Protected by dentry_lock. */
+
+#include "filesys/dentry.h"
+#include <hash.h>
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Most entries cached at once. */
+#define DENTRY_MAX 256
+
+/* A cached lookup. */
+struct dentry {
+	disk_sector_t parent;       /* Inode sector of the directory. */
+	char name[NAME_MAX + 1];    /* Name looked up in it. */
+	disk_sector_t child;        /* Inode sector found, or DENTRY_NONE. */
+	struct hash_elem elem;      /* Element in dentries. */
+	struct list_elem lru_elem;  /* Element in lru, most recent first. */
+};
+
+struct dentry_stats dentry_stats;
+
+static struct hash dentries;
+static struct list lru;
+static size_t dentry_cnt;
+static struct lock dentry_lock;
+
+static uint64_t
+dentry_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct dentry *d = hash_entry (e, struct dentry, elem);
+
+	return hash_string (d->name) ^ hash_int (d->parent);
+}
+
+static bool
+dentry_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct dentry *a = hash_entry (a_, struct dentry, elem);
+	const struct dentry *b = hash_entry (b_, struct dentry, elem);
+
+	if (a->parent != b->parent)
+		return a->parent < b->parent;
+	return strcmp (a->name, b->name) < 0;
+}
+
+/* Initializes the dentry cache. */
+void
+dentry_init (void) {
+	if (!hash_init (&dentries, dentry_hash, dentry_less, NULL))
+		PANIC ("dentry cache creation failed");
+	list_init (&lru);
+	lock_init (&dentry_lock);
+}
+
+/* Returns the entry for NAME in PARENT, or NULL.  Must be called with
+ * dentry_lock held. */
+static struct dentry *
+find (disk_sector_t parent, const char *name) {
+	struct dentry key;
+	struct hash_elem *e;
+
+	key.parent = parent;
+	strlcpy (key.name, name, sizeof key.name);
+	e = hash_find (&dentries, &key.elem);
+	return e != NULL ? hash_entry (e, struct dentry, elem) : NULL;
+}
+
+/* Removes D from the cache and frees it.  Must be called with
+ * dentry_lock held. */
+static void
+drop (struct dentry *d) {
+	hash_delete (&dentries, &d->elem);
+	list_remove (&d->lru_elem);
+	dentry_cnt--;
+	free (d);
+}
+
+/* Looks up NAME in the directory whose inode is in sector PARENT.  If
+ * the cache knows the answer, stores the inode sector of the file into
+ * *CHILD, DENTRY_NONE if there is no such file, and returns true.
+ * Otherwise returns false and the caller has to search the directory. */
+bool
+dentry_lookup (disk_sector_t parent, const char *name,
+		disk_sector_t *child) {
+	struct dentry *d = NULL;
+
+	if (strlen (name) > NAME_MAX)
+		return false;
+
+	lock_acquire (&dentry_lock);
+	d = find (parent, name);
+	if (d != NULL) {
+		list_remove (&d->lru_elem);
+		list_push_front (&lru, &d->lru_elem);
+		*child = d->child;
+		if (d->child != DENTRY_NONE)
+			dentry_stats.hits++;
+		else
+			dentry_stats.negative++;
+	} else
+		dentry_stats.misses++;
+	lock_release (&dentry_lock);
+	return d != NULL;
+}
+
+/* Records that NAME in the directory whose inode is in sector PARENT is
+ * the file whose inode is in sector CHILD, or that there is no such file
+ * if CHILD is DENTRY_NONE. */
+void
+dentry_insert (disk_sector_t parent, const char *name,
+		disk_sector_t child) {
+	struct dentry *d;
+
+	if (strlen (name) > NAME_MAX)
+		return;
+
+	lock_acquire (&dentry_lock);
+	d = find (parent, name);
+	if (d == NULL) {
+		if (dentry_cnt >= DENTRY_MAX) {
+			drop (list_entry (list_back (&lru), struct dentry, lru_elem));
+			dentry_stats.evicted++;
+		}
+		d = malloc (sizeof *d);
+		if (d == NULL)
+			goto done;
+		d->parent = parent;
+		strlcpy (d->name, name, sizeof d->name);
+		hash_insert (&dentries, &d->elem);
+		dentry_cnt++;
+	} else
+		list_remove (&d->lru_elem);
+	d->child = child;
+	list_push_front (&lru, &d->lru_elem);
+
+done:
+	lock_release (&dentry_lock);
+}
+
+/* Forgets what is known about NAME in the directory whose inode is in
+ * sector PARENT. */
+void
+dentry_invalidate (disk_sector_t parent, const char *name) {
+	struct dentry *d;
+
+	if (strlen (name) > NAME_MAX)
+		return;
+
+	lock_acquire (&dentry_lock);
+	d = find (parent, name);
+	if (d != NULL)
+		drop (d);
+	lock_release (&dentry_lock);
+}
+
+/* Prints dentry cache statistics. */
+void
+dentry_print_stats (void) {
+	printf ("Dentry cache: %llu hits, %llu negative hits, %llu misses, "
+			"%llu evicted\n",
+			dentry_stats.hits, dentry_stats.negative, dentry_stats.misses,
+			dentry_stats.evicted);
+}
@@ -1,29 +1,123 @@
 #include "filesys/directory.h"
+#include <hash.h>
 #include <stdio.h>
 #include <string.h>
 #include <list.h>
+#include "filesys/dentry.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
+#ifdef EFILESYS
+#include "filesys/fat.h"
+#endif
 
-/* A directory. */
+/* Identifies a directory. */
+#define DIR_MAGIC 0x44495231
+
+/* Number of entry slots past which a directory gets a hash index.
+ * Smaller directories are scanned. */
+#define DIR_INDEX_MIN 32
+
+/* Index bucket values besides slot numbers plus one. */
+#define BUCKET_EMPTY 0                  /* Never used. */
+#define BUCKET_DELETED UINT32_MAX       /* Entry removed. */
+
+/* A directory.  Another handle for the same directory may give it an
+ * index, so INDEX is checked against the header before each use. */
 struct dir {
 	struct inode *inode;                /* Backing store. */
+	struct inode *index;                /* Hash index, or null. */
 	off_t pos;                          /* Current position. */
 };
 
-/* A single directory entry. */
+/* Start of a directory's file.  Entry slots follow it. */
+struct dir_header {
+	unsigned magic;                     /* Magic number. */
+	disk_sector_t index;                /* Inode of the index, 0 if none. */
+	uint32_t free;                      /* First free slot plus one. */
+};
+
+/* A single directory entry.  A free entry holds the next free slot plus
+ * one, or 0, in INODE_SECTOR. */
 struct dir_entry {
 	disk_sector_t inode_sector;         /* Sector number of header. */
 	char name[NAME_MAX + 1];            /* Null terminated file name. */
 	bool in_use;                        /* In use or free? */
 };
 
+/* Start of a directory's hash index, a file of its own.  Buckets follow
+ * it, each holding the slot plus one of an entry, BUCKET_EMPTY or
+ * BUCKET_DELETED.  Collisions are resolved by linear probing. */
+struct index_header {
+	uint32_t bucket_cnt;                /* Number of buckets, a power of 2. */
+	uint32_t used;                      /* Buckets not empty. */
+};
+
+/* Serializes lookups and changes of directory entries, so that they
+ * need not hold the file system lock.  Taken before any inode lock. */
+static struct lock dir_lock;
+
+static bool add_entry (struct dir *, const char *name,
+		disk_sector_t inode_sector);
+
+/* Initializes the directory module. */
+void
+dir_init (void) {
+	lock_init (&dir_lock);
+}
+
+/* Returns the offset of entry slot SLOT in a directory's file. */
+static inline off_t
+slot_ofs (uint32_t slot) {
+	return sizeof (struct dir_header) + slot * sizeof (struct dir_entry);
+}
+
+/* Returns the number of entry slots of DIR. */
+static uint32_t
+slot_cnt (const struct dir *dir) {
+	return (inode_length (dir->inode) - sizeof (struct dir_header))
+		/ sizeof (struct dir_entry);
+}
+
+/* Returns the offset of bucket B in an index. */
+static inline off_t
+bucket_ofs (uint32_t b) {
+	return sizeof (struct index_header) + b * sizeof (uint32_t);
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
- * given SECTOR.  Returns true if successful, false on failure. */
+ * given SECTOR.  Returns true if successful, false on failure.
+ * The directory grows as entries are added. */
 bool
 dir_create (disk_sector_t sector, size_t entry_cnt) {
-	return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+	struct dir_header h = {
+		.magic = DIR_MAGIC,
+		.index = 0,
+		.free = entry_cnt > 0 ? 1 : 0,
+	};
+	struct inode *inode;
+	bool success;
+	size_t i;
+
+	if (!inode_create (sector, slot_ofs (entry_cnt)))
+		return false;
+	inode = inode_open (sector);
+	if (inode == NULL)
+		return false;
+
+	/* Chain the empty slots into the free list. */
+	success = inode_write_at (inode, &h, sizeof h, 0) == sizeof h;
+	for (i = 0; success && i < entry_cnt; i++) {
+		struct dir_entry e = {
+			.inode_sector = i + 1 < entry_cnt ? i + 2 : 0,
+			.in_use = false,
+		};
+		success = inode_write_at (inode, &e, sizeof e, slot_ofs (i))
+			== sizeof e;
+	}
+	inode_close (inode);
+	return success;
 }
 
 /* Opens and returns the directory for the given INODE, of which
@@ -31,22 +125,31 @@ dir_create (disk_sector_t sector, size_t entry_cnt) {
 struct dir *
 dir_open (struct inode *inode) {
 	struct dir *dir = calloc (1, sizeof *dir);
-	if (inode != NULL && dir != NULL) {
+	struct dir_header h;
+
+	if (inode != NULL && dir != NULL
+			&& inode_read_at (inode, &h, sizeof h, 0) == sizeof h
+			&& h.magic == DIR_MAGIC) {
 		dir->inode = inode;
-		dir->pos = 0;
+		dir->index = NULL;
+		dir->pos = sizeof h;
 		return dir;
-	} else {
-		inode_close (inode);
-		free (dir);
-		return NULL;
 	}
+
+	inode_close (inode);
+	free (dir);
+	return NULL;
 }
 
 /* Opens the root directory and returns a directory for it.
  * Return true if successful, false on failure. */
 struct dir *
 dir_open_root (void) {
+#ifdef EFILESYS
+	return dir_open (inode_open (cluster_to_sector (ROOT_DIR_CLUSTER)));
+#else
 	return dir_open (inode_open (ROOT_DIR_SECTOR));
+#endif
 }
 
 /* Opens and returns a new directory for the same inode as DIR.
@@ -60,6 +163,7 @@ dir_reopen (struct dir *dir) {
 void
 dir_close (struct dir *dir) {
 	if (dir != NULL) {
+		inode_close (dir->index);
 		inode_close (dir->inode);
 		free (dir);
 	}
@@ -71,27 +175,191 @@ dir_get_inode (struct dir *dir) {
 	return dir->inode;
 }
 
+/* Reads entry slot SLOT of DIR into *E.  Returns false past the end. */
+static bool
+read_slot (const struct dir *dir, uint32_t slot, struct dir_entry *e) {
+	return inode_read_at (dir->inode, e, sizeof *e, slot_ofs (slot))
+		== sizeof *e;
+}
+
+/* Writes *E to entry slot SLOT of DIR, which grows if SLOT is past its
+ * end.  Returns false on failure. */
+static bool
+write_slot (struct dir *dir, uint32_t slot, const struct dir_entry *e) {
+	return inode_write_at (dir->inode, e, sizeof *e, slot_ofs (slot))
+		== sizeof *e;
+}
+
+/* Reads bucket B of DIR's index. */
+static uint32_t
+read_bucket (const struct dir *dir, uint32_t b) {
+	uint32_t v = BUCKET_EMPTY;
+
+	inode_read_at (dir->index, &v, sizeof v, bucket_ofs (b));
+	return v;
+}
+
+/* Writes V to bucket B of DIR's index. */
+static bool
+write_bucket (struct dir *dir, uint32_t b, uint32_t v) {
+	return inode_write_at (dir->index, &v, sizeof v, bucket_ofs (b))
+		== sizeof v;
+}
+
+/* Searches DIR's index for an entry named NAME and returns its slot, or
+ * -1.  If EP is non-null, the entry goes into *EP. */
+static int64_t
+index_lookup (const struct dir *dir, const char *name,
+		struct dir_entry *ep) {
+	struct index_header ih;
+	uint32_t b, i;
+
+	if (inode_read_at (dir->index, &ih, sizeof ih, 0) != sizeof ih)
+		return -1;
+	b = hash_string (name) & (ih.bucket_cnt - 1);
+	for (i = 0; i < ih.bucket_cnt; i++, b = (b + 1) & (ih.bucket_cnt - 1)) {
+		uint32_t v = read_bucket (dir, b);
+		struct dir_entry e;
+
+		if (v == BUCKET_EMPTY)
+			break;
+		if (v != BUCKET_DELETED && read_slot (dir, v - 1, &e)
+				&& e.in_use && !strcmp (name, e.name)) {
+			if (ep != NULL)
+				*ep = e;
+			return v - 1;
+		}
+	}
+	return -1;
+}
+
+/* Adds the entry NAME in SLOT to DIR's index, whose header is *IH.
+ * Returns false on failure. */
+static bool
+index_insert (struct dir *dir, struct index_header *ih, const char *name,
+		uint32_t slot) {
+	uint32_t b = hash_string (name) & (ih->bucket_cnt - 1);
+
+	for (;;) {
+		uint32_t v = read_bucket (dir, b);
+
+		if (v == BUCKET_EMPTY || v == BUCKET_DELETED) {
+			if (v == BUCKET_EMPTY)
+				ih->used++;
+			return write_bucket (dir, b, slot + 1);
+		}
+		b = (b + 1) & (ih->bucket_cnt - 1);
+	}
+}
+
+/* Rebuilds DIR's index with enough buckets for its entries, dropping
+ * the deleted ones.  Rebuilding when the index fills up costs time in
+ * proportion to the entries, so each addition costs O(1) amortized.
+ * Returns false on failure. */
+static bool
+index_rebuild (struct dir *dir) {
+	static const uint32_t zeros[DISK_SECTOR_SIZE / sizeof (uint32_t)];
+	struct index_header ih = { .bucket_cnt = 64, .used = 0 };
+	uint32_t slots = slot_cnt (dir), slot;
+	off_t ofs, end;
+	struct dir_entry e;
+
+	/* At most a quarter full once rebuilt. */
+	while (ih.bucket_cnt < slots * 4)
+		ih.bucket_cnt *= 2;
+
+	end = bucket_ofs (ih.bucket_cnt);
+	for (ofs = bucket_ofs (0); ofs < end; ofs += sizeof zeros) {
+		off_t chunk = end - ofs < (off_t) sizeof zeros
+			? end - ofs : (off_t) sizeof zeros;
+		if (inode_write_at (dir->index, zeros, chunk, ofs) != chunk)
+			return false;
+	}
+	for (slot = 0; read_slot (dir, slot, &e); slot++)
+		if (e.in_use && !index_insert (dir, &ih, e.name, slot))
+			return false;
+	return inode_write_at (dir->index, &ih, sizeof ih, 0) == sizeof ih;
+}
+
+/* Gives DIR a hash index.  Returns false on failure, leaving DIR to be
+ * scanned. */
+static bool
+index_create (struct dir *dir, struct dir_header *h) {
+	disk_sector_t sector;
+
+	if (!filesys_alloc_inode (&sector))
+		return false;
+	if (!inode_create (sector, 0)) {
+		filesys_free_inode (sector);
+		return false;
+	}
+	dir->index = inode_open (sector);
+	if (dir->index == NULL) {
+		filesys_free_inode (sector);
+		return false;
+	}
+	if (!index_rebuild (dir)) {
+		inode_remove (dir->index);
+		inode_close (dir->index);
+		dir->index = NULL;
+		return false;
+	}
+	h->index = sector;
+	return true;
+}
+
+/* Reads DIR's header into *H and opens the index it names, if DIR does
+ * not have it open already: the index may have been created through
+ * another handle since DIR was opened.  Returns false on failure.  Must
+ * be called with dir_lock held. */
+static bool
+sync_index (struct dir *dir, struct dir_header *h) {
+	ASSERT (lock_held_by_current_thread (&dir_lock));
+
+	if (inode_read_at (dir->inode, h, sizeof *h, 0) != sizeof *h)
+		return false;
+	if (dir->index != NULL && inode_get_inumber (dir->index) == h->index)
+		return true;
+
+	inode_close (dir->index);
+	dir->index = NULL;
+	if (h->index != 0) {
+		dir->index = inode_open (h->index);
+		if (dir->index == NULL)
+			return false;
+	}
+	return true;
+}
+
 /* Searches DIR for a file with the given NAME.
  * If successful, returns true, sets *EP to the directory entry
  * if EP is non-null, and sets *OFSP to the byte offset of the
  * directory entry if OFSP is non-null.
- * otherwise, returns false and ignores EP and OFSP. */
+ * otherwise, returns false and ignores EP and OFSP.
+ * Directories with an index look NAME up in it; small ones are
+ * scanned.  Must be called with dir_lock held, after sync_index (). */
 static bool
 lookup (const struct dir *dir, const char *name,
 		struct dir_entry *ep, off_t *ofsp) {
 	struct dir_entry e;
-	size_t ofs;
+	uint32_t slot;
 
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
-	for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-			ofs += sizeof e)
+	if (dir->index != NULL) {
+		int64_t found = index_lookup (dir, name, ep);
+		if (found >= 0 && ofsp != NULL)
+			*ofsp = slot_ofs (found);
+		return found >= 0;
+	}
+
+	for (slot = 0; read_slot (dir, slot, &e); slot++)
 		if (e.in_use && !strcmp (name, e.name)) {
 			if (ep != NULL)
 				*ep = e;
 			if (ofsp != NULL)
-				*ofsp = ofs;
+				*ofsp = slot_ofs (slot);
 			return true;
 		}
 	return false;
@@ -100,19 +368,30 @@ lookup (const struct dir *dir, const char *name,
 /* Searches DIR for a file with the given NAME
  * and returns true if one exists, false otherwise.
  * On success, sets *INODE to an inode for the file, otherwise to
- * a null pointer.  The caller must close *INODE. */
+ * a null pointer.  The caller must close *INODE.
+ * Answers, including that there is no such file, are kept in the
+ * dentry cache. */
 bool
-dir_lookup (const struct dir *dir, const char *name,
-		struct inode **inode) {
+dir_lookup (struct dir *dir, const char *name, struct inode **inode) {
+	disk_sector_t parent, sector;
+	struct dir_header h;
 	struct dir_entry e;
 
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
-	if (lookup (dir, name, &e, NULL))
-		*inode = inode_open (e.inode_sector);
-	else
-		*inode = NULL;
+	parent = inode_get_inumber (dir->inode);
+	lock_acquire (&dir_lock);
+	if (!dentry_lookup (parent, name, &sector)) {
+		sector = DENTRY_NONE;
+		if (sync_index (dir, &h)) {
+			if (lookup (dir, name, &e, NULL))
+				sector = e.inode_sector;
+			dentry_insert (parent, name, sector);
+		}
+	}
+	*inode = sector != DENTRY_NONE ? inode_open (sector) : NULL;
+	lock_release (&dir_lock);
 
 	return *inode != NULL;
 }
@@ -122,12 +401,11 @@ dir_lookup (const struct dir *dir, const char *name,
  * INODE_SECTOR.
  * Returns true if successful, false on failure.
  * Fails if NAME is invalid (i.e. too long) or a disk or memory
- * error occurs. */
+ * error occurs.
+ * The entry takes the first free slot, or a new one at the end. */
 bool
 dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
-	struct dir_entry e;
-	off_t ofs;
-	bool success = false;
+	bool success;
 
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
@@ -136,30 +414,52 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
 	if (*name == '\0' || strlen (name) > NAME_MAX)
 		return false;
 
-	/* Check that NAME is not in use. */
-	if (lookup (dir, name, NULL, NULL))
-		goto done;
+	lock_acquire (&dir_lock);
+	success = add_entry (dir, name, inode_sector);
+	lock_release (&dir_lock);
+	return success;
+}
 
-	/* Set OFS to offset of free slot.
-	 * If there are no free slots, then it will be set to the
-	 * current end-of-file.
+/* Does the work of dir_add () with dir_lock held. */
+static bool
+add_entry (struct dir *dir, const char *name, disk_sector_t inode_sector) {
+	struct dir_header h;
+	struct dir_entry e;
+	uint32_t slot;
 
-	 * inode_read_at() will only return a short read at end of file.
-	 * Otherwise, we'd need to verify that we didn't get a short
-	 * read due to something intermittent such as low memory. */
-	for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-			ofs += sizeof e)
-		if (!e.in_use)
-			break;
+	/* Check that NAME is not in use. */
+	if (!sync_index (dir, &h) || lookup (dir, name, NULL, NULL))
+		return false;
+
+	if (h.free != 0) {
+		slot = h.free - 1;
+		if (!read_slot (dir, slot, &e))
+			return false;
+		h.free = e.inode_sector;
+	} else
+		slot = slot_cnt (dir);
 
 	/* Write slot. */
 	e.in_use = true;
 	strlcpy (e.name, name, sizeof e.name);
 	e.inode_sector = inode_sector;
-	success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+	if (!write_slot (dir, slot, &e))
+		return false;
+	dentry_invalidate (inode_get_inumber (dir->inode), name);
 
-done:
-	return success;
+	if (dir->index != NULL) {
+		struct index_header ih;
+
+		if (inode_read_at (dir->index, &ih, sizeof ih, 0) != sizeof ih
+				|| !index_insert (dir, &ih, name, slot))
+			return false;
+		if (ih.used * 2 > ih.bucket_cnt ? !index_rebuild (dir)
+				: inode_write_at (dir->index, &ih, sizeof ih, 0) != sizeof ih)
+			return false;
+	} else if (h.index == 0 && slot_cnt (dir) > DIR_INDEX_MIN)
+		index_create (dir, &h);
+
+	return inode_write_at (dir->inode, &h, sizeof h, 0) == sizeof h;
 }
 
 /* Removes any entry for NAME in DIR.
@@ -167,6 +467,7 @@ done:
  * which occurs only if there is no file with the given NAME. */
 bool
 dir_remove (struct dir *dir, const char *name) {
+	struct dir_header h;
 	struct dir_entry e;
 	struct inode *inode = NULL;
 	bool success = false;
@@ -175,8 +476,10 @@ dir_remove (struct dir *dir, const char *name) {
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
+	lock_acquire (&dir_lock);
+
 	/* Find directory entry. */
-	if (!lookup (dir, name, &e, &ofs))
+	if (!sync_index (dir, &h) || !lookup (dir, name, &e, &ofs))
 		goto done;
 
 	/* Open inode. */
@@ -184,9 +487,29 @@ dir_remove (struct dir *dir, const char *name) {
 	if (inode == NULL)
 		goto done;
 
-	/* Erase directory entry. */
+	/* Drop it from the index first, while its name is still there. */
+	if (dir->index != NULL) {
+		struct index_header ih;
+		uint32_t slot = (ofs - slot_ofs (0)) / sizeof e;
+		uint32_t b, i;
+
+		if (inode_read_at (dir->index, &ih, sizeof ih, 0) != sizeof ih)
+			goto done;
+		b = hash_string (name) & (ih.bucket_cnt - 1);
+		for (i = 0; i < ih.bucket_cnt && read_bucket (dir, b) != slot + 1; i++)
+			b = (b + 1) & (ih.bucket_cnt - 1);
+		if (i == ih.bucket_cnt || !write_bucket (dir, b, BUCKET_DELETED))
+			goto done;
+	}
+
+	dentry_invalidate (inode_get_inumber (dir->inode), name);
+
+	/* Erase directory entry, putting its slot on the free list. */
 	e.in_use = false;
-	if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
+	e.inode_sector = h.free;
+	h.free = (ofs - slot_ofs (0)) / sizeof e + 1;
+	if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e
+			|| inode_write_at (dir->inode, &h, sizeof h, 0) != sizeof h)
 		goto done;
 
 	/* Remove inode. */
@@ -195,6 +518,7 @@ dir_remove (struct dir *dir, const char *name) {
 
 done:
 	inode_close (inode);
+	lock_release (&dir_lock);
 	return success;
 }
 
@@ -204,13 +528,17 @@ done:
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1]) {
 	struct dir_entry e;
+	bool found = false;
 
-	while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) {
+	lock_acquire (&dir_lock);
+	while (!found
+			&& inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) {
 		dir->pos += sizeof e;
 		if (e.in_use) {
 			strlcpy (name, e.name, NAME_MAX + 1);
-			return true;
+			found = true;
 		}
 	}
-	return false;
+	lock_release (&dir_lock);
+	return found;
 }
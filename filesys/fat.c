@@ -1,15 +1,28 @@
 #include "filesys/fat.h"
+#include <bitmap.h>
 #include "devices/disk.h"
+#include "devices/timer.h"
+#include "filesys/buffer_cache.h"
 #include "filesys/filesys.h"
 #include "threads/malloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include <stdio.h>
 #include <string.h>
 
+/* Clusters between two positions a chain cache remembers. */
+#define FAT_CHAIN_STRIDE 16
+
+/* FAT entries in one FAT sector. */
+#define FAT_ENTRIES (DISK_SECTOR_SIZE / sizeof (cluster_t))
+
+/* Ticks between two runs of the FAT writer. */
+#define FAT_WRITEBACK_INTERVAL TIMER_FREQ
+
 /* Should be less than DISK_SECTOR_SIZE */
 struct fat_boot {
 	unsigned int magic;
-	unsigned int sectors_per_cluster; /* Fixed to 1 */
+	unsigned int sectors_per_cluster; /* Chosen at format time. */
 	unsigned int total_sectors;
 	unsigned int fat_start;
 	unsigned int fat_sectors; /* Size of FAT in sectors. */
@@ -22,14 +35,24 @@ struct fat_fs {
 	unsigned int *fat;
 	unsigned int fat_length;
 	disk_sector_t data_start;
-	cluster_t last_clst;
-	struct lock write_lock;
+	cluster_t last_clst;        /* Where the next free cluster is sought. */
+	struct bitmap *free_map;    /* Clusters in use, as far as loaded. */
+	struct bitmap *loaded;      /* FAT sectors read into FAT. */
+	struct bitmap *dirty;       /* FAT sectors changed since written. */
+	struct lock write_lock;     /* Serializes allocation and loading. */
 };
 
 static struct fat_fs *fat_fs;
 
+unsigned int fat_format_cluster_sectors = 1;
+
 void fat_boot_create (void);
 void fat_fs_init (void);
+static void fat_table_init (void);
+static void fat_free_map_init (void);
+static void fat_load (cluster_t clst);
+static void fat_flush (void);
+static thread_func fat_writer;
 
 void
 fat_init (void) {
@@ -51,35 +74,26 @@ fat_init (void) {
 	fat_fs_init ();
 }
 
+/* Mounts the FAT.  Nothing of the table is read yet: each FAT sector is
+ * loaded when an entry in it is first needed, so that mounting takes the
+ * same time however large the disk. */
 void
 fat_open (void) {
-	fat_fs->fat = calloc (fat_fs->fat_length, sizeof (cluster_t));
-	if (fat_fs->fat == NULL)
-		PANIC ("FAT load failed");
+	static bool writer_started;
 
-	// Load FAT directly from the disk
-	uint8_t *buffer = (uint8_t *) fat_fs->fat;
-	off_t bytes_read = 0;
-	off_t bytes_left = sizeof (fat_fs->fat);
-	const off_t fat_size_in_bytes = fat_fs->fat_length * sizeof (cluster_t);
-	for (unsigned i = 0; i < fat_fs->bs.fat_sectors; i++) {
-		bytes_left = fat_size_in_bytes - bytes_read;
-		if (bytes_left >= DISK_SECTOR_SIZE) {
-			disk_read (filesys_disk, fat_fs->bs.fat_start + i,
-			           buffer + bytes_read);
-			bytes_read += DISK_SECTOR_SIZE;
-		} else {
-			uint8_t *bounce = malloc (DISK_SECTOR_SIZE);
-			if (bounce == NULL)
-				PANIC ("FAT load failed");
-			disk_read (filesys_disk, fat_fs->bs.fat_start + i, bounce);
-			memcpy (buffer + bytes_read, bounce, bytes_left);
-			bytes_read += bytes_left;
-			free (bounce);
-		}
+	fat_table_init ();
+	bitmap_set_all (fat_fs->loaded, false);
+	bitmap_set_all (fat_fs->dirty, false);
+	fat_free_map_init ();
+
+	if (!writer_started) {
+		writer_started = true;
+		thread_create ("fat_writer", PRI_DEFAULT, fat_writer, NULL);
 	}
 }
 
+/* Writes the boot sector and the FAT sectors changed since they were last
+ * written, so that unmounting takes time in proportion to what changed. */
 void
 fat_close (void) {
 	// Write FAT boot sector
@@ -90,27 +104,7 @@ fat_close (void) {
 	disk_write (filesys_disk, FAT_BOOT_SECTOR, bounce);
 	free (bounce);
 
-	// Write FAT directly to the disk
-	uint8_t *buffer = (uint8_t *) fat_fs->fat;
-	off_t bytes_wrote = 0;
-	off_t bytes_left = sizeof (fat_fs->fat);
-	const off_t fat_size_in_bytes = fat_fs->fat_length * sizeof (cluster_t);
-	for (unsigned i = 0; i < fat_fs->bs.fat_sectors; i++) {
-		bytes_left = fat_size_in_bytes - bytes_wrote;
-		if (bytes_left >= DISK_SECTOR_SIZE) {
-			disk_write (filesys_disk, fat_fs->bs.fat_start + i,
-			            buffer + bytes_wrote);
-			bytes_wrote += DISK_SECTOR_SIZE;
-		} else {
-			bounce = calloc (1, DISK_SECTOR_SIZE);
-			if (bounce == NULL)
-				PANIC ("FAT close failed");
-			memcpy (bounce, buffer + bytes_wrote, bytes_left);
-			disk_write (filesys_disk, fat_fs->bs.fat_start + i, bounce);
-			bytes_wrote += bytes_left;
-			free (bounce);
-		}
-	}
+	fat_flush ();
 }
 
 void
@@ -119,10 +113,11 @@ fat_create (void) {
 	fat_boot_create ();
 	fat_fs_init ();
 
-	// Create FAT table
-	fat_fs->fat = calloc (fat_fs->fat_length, sizeof (cluster_t));
-	if (fat_fs->fat == NULL)
-		PANIC ("FAT creation failed");
+	// Create FAT table, to be written in full
+	fat_table_init ();
+	bitmap_set_all (fat_fs->loaded, true);
+	bitmap_set_all (fat_fs->dirty, true);
+	fat_free_map_init ();
 
 	// Set up ROOT_DIR_CLST
 	fat_put (ROOT_DIR_CLUSTER, EOChain);
@@ -131,18 +126,28 @@ fat_create (void) {
 	uint8_t *buf = calloc (1, DISK_SECTOR_SIZE);
 	if (buf == NULL)
 		PANIC ("FAT create failed due to OOM");
-	disk_write (filesys_disk, cluster_to_sector (ROOT_DIR_CLUSTER), buf);
+	for (unsigned i = 0; i < fat_cluster_sectors (); i++)
+		buffer_cache_write (cluster_to_sector (ROOT_DIR_CLUSTER) + i, buf, 0,
+				DISK_SECTOR_SIZE);
 	free (buf);
 }
 
+/* Sets up a boot sector for clusters of fat_format_cluster_sectors
+ * sectors, which is brought to the nearest power of two from 1 to
+ * FAT_CLUSTER_MAX.  Larger clusters take fewer FAT entries and keep more
+ * of a file in one run, at the cost of space at the end of small files. */
 void
 fat_boot_create (void) {
+	unsigned int spc = 1;
+	while (spc < fat_format_cluster_sectors && spc < FAT_CLUSTER_MAX)
+		spc *= 2;
+
 	unsigned int fat_sectors =
 	    (disk_size (filesys_disk) - 1)
-	    / (DISK_SECTOR_SIZE / sizeof (cluster_t) * SECTORS_PER_CLUSTER + 1) + 1;
+	    / (DISK_SECTOR_SIZE / sizeof (cluster_t) * spc + 1) + 1;
 	fat_fs->bs = (struct fat_boot){
 	    .magic = FAT_MAGIC,
-	    .sectors_per_cluster = SECTORS_PER_CLUSTER,
+	    .sectors_per_cluster = spc,
 	    .total_sectors = disk_size (filesys_disk),
 	    .fat_start = 1,
 	    .fat_sectors = fat_sectors,
@@ -152,7 +157,111 @@ fat_boot_create (void) {
 
 void
 fat_fs_init (void) {
-	/* TODO: Your code goes here. */
+	size_t max_length = fat_fs->bs.fat_sectors
+		* (DISK_SECTOR_SIZE / sizeof (cluster_t));
+
+	/* Clusters are numbered from 1; entry 0 of the FAT is never used. */
+	fat_fs->data_start = fat_fs->bs.fat_start + fat_fs->bs.fat_sectors;
+	fat_fs->fat_length = (fat_fs->bs.total_sectors - fat_fs->data_start)
+		/ fat_cluster_sectors () + 1;
+	if (fat_fs->fat_length > max_length)
+		fat_fs->fat_length = max_length;
+	fat_fs->last_clst = ROOT_DIR_CLUSTER;
+	lock_init (&fat_fs->write_lock);
+}
+
+/* Allocates the in-memory FAT, with room for whole FAT sectors, and the
+ * maps of loaded and dirty FAT sectors. */
+static void
+fat_table_init (void) {
+	free (fat_fs->fat);
+	fat_fs->fat = calloc (fat_fs->bs.fat_sectors, DISK_SECTOR_SIZE);
+	if (fat_fs->fat == NULL)
+		PANIC ("FAT load failed");
+	if (fat_fs->loaded == NULL)
+		fat_fs->loaded = bitmap_create (fat_fs->bs.fat_sectors);
+	if (fat_fs->dirty == NULL)
+		fat_fs->dirty = bitmap_create (fat_fs->bs.fat_sectors);
+	if (fat_fs->loaded == NULL || fat_fs->dirty == NULL)
+		PANIC ("FAT load failed");
+}
+
+/* Sets up the map of clusters in use from the part of the FAT loaded.
+ * Clusters of FAT sectors not loaded yet count as free until they are
+ * looked at. */
+static void
+fat_free_map_init (void) {
+	cluster_t clst;
+
+	if (fat_fs->free_map != NULL)
+		bitmap_destroy (fat_fs->free_map);
+	fat_fs->free_map = bitmap_create (fat_fs->fat_length);
+	if (fat_fs->free_map == NULL)
+		PANIC ("FAT free map creation failed");
+	bitmap_mark (fat_fs->free_map, 0);
+	for (clst = 1; clst < fat_fs->fat_length; clst++)
+		if (fat_fs->fat[clst] != 0)
+			bitmap_mark (fat_fs->free_map, clst);
+}
+
+/* Makes sure the FAT sector holding the entry of CLST is loaded. */
+static void
+fat_load (cluster_t clst) {
+	size_t sector = clst / FAT_ENTRIES;
+	bool held;
+
+	if (bitmap_test (fat_fs->loaded, sector))
+		return;
+
+	held = lock_held_by_current_thread (&fat_fs->write_lock);
+	if (!held)
+		lock_acquire (&fat_fs->write_lock);
+	if (!bitmap_test (fat_fs->loaded, sector)) {
+		cluster_t first = sector * FAT_ENTRIES, c;
+
+		disk_read (filesys_disk, fat_fs->bs.fat_start + sector,
+				fat_fs->fat + first);
+		for (c = first; c < first + FAT_ENTRIES && c < fat_fs->fat_length;
+				c++)
+			if (c != 0)
+				bitmap_set (fat_fs->free_map, c, fat_fs->fat[c] != 0);
+		bitmap_mark (fat_fs->loaded, sector);
+	}
+	if (!held)
+		lock_release (&fat_fs->write_lock);
+}
+
+/* Writes the FAT sectors changed since they were last written.  An entry
+ * changed while its sector is being written marks the sector dirty
+ * again. */
+static void
+fat_flush (void) {
+	size_t sector = 0;
+
+	for (;;) {
+		lock_acquire (&fat_fs->write_lock);
+		sector = bitmap_scan (fat_fs->dirty, sector, 1, true);
+		if (sector != BITMAP_ERROR)
+			bitmap_reset (fat_fs->dirty, sector);
+		lock_release (&fat_fs->write_lock);
+		if (sector == BITMAP_ERROR)
+			break;
+
+		disk_write (filesys_disk, fat_fs->bs.fat_start + sector,
+				fat_fs->fat + sector * FAT_ENTRIES);
+		sector++;
+	}
+}
+
+/* The FAT writer.  Writes changed FAT sectors every
+ * FAT_WRITEBACK_INTERVAL ticks, so that little of the FAT is lost in a
+ * crash and little is left to write at unmount. */
+static void
+fat_writer (void *aux UNUSED) {
+	for (;;) {
+		timer_sleep (FAT_WRITEBACK_INTERVAL);
+		fat_flush ();
+	}
 }
 
 /*----------------------------------------------------------------------------*/
@@ -161,33 +270,184 @@ fat_fs_init (void) {
 
 /* Add a cluster to the chain.
  * If CLST is 0, start a new chain.
- * Returns 0 if fails to allocate a new cluster. */
+ * Returns 0 if fails to allocate a new cluster.
+ * Free clusters are found in the map of clusters in use, next-fit from
+ * the cluster allocated last, so that a chain grown by itself stays in
+ * one run. */
 cluster_t
 fat_create_chain (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	size_t new;
+
+	lock_acquire (&fat_fs->write_lock);
+	for (;;) {
+		new = bitmap_scan (fat_fs->free_map, fat_fs->last_clst, 1, false);
+		if (new == BITMAP_ERROR)
+			new = bitmap_scan (fat_fs->free_map, 1, 1, false);
+		if (new == BITMAP_ERROR) {
+			lock_release (&fat_fs->write_lock);
+			return 0;
+		}
+
+		/* A cluster whose FAT sector was never loaded may be in use. */
+		if (bitmap_test (fat_fs->loaded, new / FAT_ENTRIES))
+			break;
+		fat_load (new);
+	}
+
+	fat_put (new, EOChain);
+	if (clst != 0)
+		fat_put (clst, new);
+	fat_fs->last_clst = new;
+	lock_release (&fat_fs->write_lock);
+	return new;
 }
 
 /* Remove the chain of clusters starting from CLST.
  * If PCLST is 0, assume CLST as the start of the chain. */
 void
 fat_remove_chain (cluster_t clst, cluster_t pclst) {
-	/* TODO: Your code goes here. */
+	lock_acquire (&fat_fs->write_lock);
+	while (clst != 0 && clst != EOChain) {
+		cluster_t next = fat_get (clst);
+		fat_put (clst, 0);
+		clst = next;
+	}
+	if (pclst != 0)
+		fat_put (pclst, EOChain);
+	lock_release (&fat_fs->write_lock);
 }
 
 /* Update a value in the FAT table. */
 void
 fat_put (cluster_t clst, cluster_t val) {
-	/* TODO: Your code goes here. */
+	ASSERT (clst != 0 && clst < fat_fs->fat_length);
+
+	fat_load (clst);
+	fat_fs->fat[clst] = val;
+	bitmap_set (fat_fs->free_map, clst, val != 0);
+	bitmap_mark (fat_fs->dirty, clst / FAT_ENTRIES);
 }
 
 /* Fetch a value in the FAT table. */
 cluster_t
 fat_get (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	ASSERT (clst != 0 && clst < fat_fs->fat_length);
+
+	fat_load (clst);
+	return fat_fs->fat[clst];
 }
 
 /* Covert a cluster # to a sector number. */
 disk_sector_t
 cluster_to_sector (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	ASSERT (clst != 0 && clst < fat_fs->fat_length);
+
+	return fat_fs->data_start + (clst - 1) * fat_cluster_sectors ();
+}
+
+/* Converts SECTOR, the first of a cluster, to the cluster's number. */
+cluster_t
+sector_to_cluster (disk_sector_t sector) {
+	ASSERT (sector >= fat_fs->data_start);
+	ASSERT ((sector - fat_fs->data_start) % fat_cluster_sectors () == 0);
+
+	return (sector - fat_fs->data_start) / fat_cluster_sectors () + 1;
+}
+
+/* Returns the number of sectors in a cluster of the mounted file
+ * system. */
+unsigned int
+fat_cluster_sectors (void) {
+	return fat_fs->bs.sectors_per_cluster;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Chain position cache                                                       */
+/*----------------------------------------------------------------------------*/
+
+/* Initializes CHAIN, a cache of positions in a cluster chain, as empty. */
+void
+fat_chain_init (struct fat_chain *chain) {
+	lock_init (&chain->lock);
+	chain->marks = NULL;
+	chain->mark_cnt = chain->mark_cap = 0;
+	chain->last_idx = 0;
+	chain->last = 0;
+}
+
+/* Frees the positions CHAIN remembers. */
+void
+fat_chain_destroy (struct fat_chain *chain) {
+	free (chain->marks);
+	chain->marks = NULL;
+	chain->mark_cnt = chain->mark_cap = 0;
+	chain->last = 0;
+}
+
+/* Remembers that cluster IDX of CHAIN is CLST, if IDX is the next
+ * position it keeps track of. */
+static void
+fat_chain_mark (struct fat_chain *chain, size_t idx, cluster_t clst) {
+	if (idx % FAT_CHAIN_STRIDE != 0
+			|| idx / FAT_CHAIN_STRIDE != chain->mark_cnt)
+		return;
+	if (chain->mark_cnt == chain->mark_cap) {
+		size_t cap = chain->mark_cap ? chain->mark_cap * 2 : 8;
+		cluster_t *marks = realloc (chain->marks, cap * sizeof *marks);
+		if (marks == NULL)
+			return;
+		chain->marks = marks;
+		chain->mark_cap = cap;
+	}
+	chain->marks[chain->mark_cnt++] = clst;
+}
+
+/* Returns cluster IDX, counting from 0, of the chain that starts at
+ * START, or 0 if the chain is shorter.  CHAIN caches every
+ * FAT_CHAIN_STRIDE-th cluster of the chain and the one returned last, so
+ * that a lookup follows at most FAT_CHAIN_STRIDE links, and a sequential
+ * one a single link, once the chain has been walked.  A chain may grow,
+ * but positions already cached must not change.  START must not be 0.
+ * Must be called with CHAIN's lock held. */
+static cluster_t
+fat_chain_walk (struct fat_chain *chain, cluster_t start, size_t idx) {
+	size_t pos = 0;
+	cluster_t clst = start;
+
+	if (chain->mark_cnt > 0) {
+		size_t m = idx / FAT_CHAIN_STRIDE;
+		if (m >= chain->mark_cnt)
+			m = chain->mark_cnt - 1;
+		pos = m * FAT_CHAIN_STRIDE;
+		clst = chain->marks[m];
+	}
+	if (chain->last != 0 && chain->last_idx <= idx && chain->last_idx > pos) {
+		pos = chain->last_idx;
+		clst = chain->last;
+	}
+
+	fat_chain_mark (chain, pos, clst);
+	while (pos < idx) {
+		clst = fat_get (clst);
+		if (clst == EOChain || clst == 0)
+			return 0;
+		fat_chain_mark (chain, ++pos, clst);
+	}
+	chain->last_idx = idx;
+	chain->last = clst;
+	return clst;
+}
+
+/* Returns cluster IDX of the chain that starts at START, or 0 if the
+ * chain is shorter or START is 0, as fat_chain_walk () finds it. */
+cluster_t
+fat_chain_get (struct fat_chain *chain, cluster_t start, size_t idx) {
+	cluster_t clst;
+
+	if (start == 0)
+		return 0;
+	lock_acquire (&chain->lock);
+	clst = fat_chain_walk (chain, start, idx);
+	lock_release (&chain->lock);
+	return clst;
 }
@@ -3,11 +3,20 @@
 #include "filesys/inode.h"
 #include "threads/malloc.h"
 
+/* Read-ahead window of a file found being read sequentially, in bytes.
+ * It starts at RA_MIN, doubles with every further sequential read up to
+ * RA_MAX, and is dropped on the first read elsewhere. */
+#define RA_MIN (4 * DISK_SECTOR_SIZE)
+#define RA_MAX (32 * DISK_SECTOR_SIZE)
+
 /* An open file. */
 struct file {
 	struct inode *inode;        /* File's inode. */
 	off_t pos;                  /* Current position. */
 	bool deny_write;            /* Has file_deny_write() been called? */
+	off_t ra_next;              /* Where a sequential read goes on. */
+	off_t ra_window;            /* Read-ahead window, 0 if none. */
+	off_t ra_end;               /* End of the read-ahead issued so far. */
 };
 
 /* Opens a file for the given INODE, of which it takes ownership,
@@ -64,6 +73,33 @@ file_get_inode (struct file *file) {
 	return file->inode;
 }
 
+/* Notes a read of SIZE bytes at OFS in FILE and, if FILE is being read
+ * sequentially, has the data just past the read brought in ahead of
+ * time, in the background. */
+static void
+file_readahead (struct file *file, off_t ofs, off_t size) {
+	off_t end = ofs + size;
+	off_t start;
+
+	if (ofs != file->ra_next) {
+		file->ra_window = 0;
+		file->ra_end = 0;
+	} else if (file->ra_window == 0)
+		file->ra_window = RA_MIN;
+	else if (file->ra_window < RA_MAX)
+		file->ra_window *= 2;
+	file->ra_next = end;
+	if (file->ra_window == 0)
+		return;
+
+	/* Only what earlier reads have not asked for already. */
+	start = file->ra_end > end ? file->ra_end : end;
+	if (start < end + file->ra_window) {
+		inode_readahead (file->inode, start, end + file->ra_window - start);
+		file->ra_end = end + file->ra_window;
+	}
+}
+
 /* Reads SIZE bytes from FILE into BUFFER,
  * starting at the file's current position.
  * Returns the number of bytes actually read,
@@ -71,7 +107,10 @@ file_get_inode (struct file *file) {
  * Advances FILE's position by the number of bytes read. */
 off_t
 file_read (struct file *file, void *buffer, off_t size) {
-	off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+	off_t bytes_read;
+
+	file_readahead (file, file->pos, size);
+	bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
 	file->pos += bytes_read;
 	return bytes_read;
 }
@@ -89,9 +128,8 @@ file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) {
 /* Writes SIZE bytes from BUFFER into FILE,
  * starting at the file's current position.
  * Returns the number of bytes actually written,
- * which may be less than SIZE if end of file is reached.
- * (Normally we'd grow the file in that case, but file growth is
- * not yet implemented.)
+ * which may be less than SIZE if the disk is full.
+ * Writing past end of file grows the file.
  * Advances FILE's position by the number of bytes read. */
 off_t
 file_write (struct file *file, const void *buffer, off_t size) {
@@ -103,9 +141,8 @@ file_write (struct file *file, const void *buffer, off_t size) {
 /* Writes SIZE bytes from BUFFER into FILE,
  * starting at offset FILE_OFS in the file.
  * Returns the number of bytes actually written,
- * which may be less than SIZE if end of file is reached.
- * (Normally we'd grow the file in that case, but file growth is
- * not yet implemented.)
+ * which may be less than SIZE if the disk is full.
+ * Writing past end of file grows the file.
  * The file's current position is unaffected. */
 off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
@@ -2,11 +2,19 @@
 #include <debug.h>
 #include <stdio.h>
 #include <string.h>
+#include "filesys/buffer_cache.h"
+#include "filesys/dentry.h"
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
 #include "filesys/directory.h"
 #include "devices/disk.h"
+#ifdef EFILESYS
+#include "filesys/fat.h"
+#endif
+#ifdef VM
+#include "filesys/page_cache.h"
+#endif
 
 /* The disk that contains the file system. */
 struct disk *filesys_disk;
@@ -21,7 +29,10 @@ filesys_init (bool format) {
 	if (filesys_disk == NULL)
 		PANIC ("hd0:1 (hdb) not present, file system initialization failed");
 
+	buffer_cache_init ();
 	inode_init ();
+	dir_init ();
+	dentry_init ();
 
 #ifdef EFILESYS
 	fat_init ();
@@ -45,12 +56,16 @@ filesys_init (bool format) {
  * to disk. */
 void
 filesys_done (void) {
+#ifdef VM
+	page_cache_flush ();
+#endif
 	/* Original FS */
 #ifdef EFILESYS
 	fat_close ();
 #else
 	free_map_close ();
 #endif
+	buffer_cache_flush ();
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE.
@@ -61,17 +76,43 @@ bool
 filesys_create (const char *name, off_t initial_size) {
 	disk_sector_t inode_sector = 0;
 	struct dir *dir = dir_open_root ();
-	bool success = (dir != NULL
-			&& free_map_allocate (1, &inode_sector)
+	bool allocated = dir != NULL && filesys_alloc_inode (&inode_sector);
+	bool success = (allocated
 			&& inode_create (inode_sector, initial_size)
 			&& dir_add (dir, name, inode_sector));
-	if (!success && inode_sector != 0)
-		free_map_release (inode_sector, 1);
+	if (!success && allocated)
+		filesys_free_inode (inode_sector);
 	dir_close (dir);
 
 	return success;
 }
 
+/* Allocates a sector for a new inode and stores it into *SECTORP.
+ * Returns false if the disk is full. */
+bool
+filesys_alloc_inode (disk_sector_t *sectorp) {
+#ifdef EFILESYS
+	/* The inode takes a cluster of its own. */
+	cluster_t clst = fat_create_chain (0);
+	if (clst == 0)
+		return false;
+	*sectorp = cluster_to_sector (clst);
+	return true;
+#else
+	return free_map_allocate (1, sectorp);
+#endif
+}
+
+/* Releases SECTOR, allocated by filesys_alloc_inode (). */
+void
+filesys_free_inode (disk_sector_t sector) {
+#ifdef EFILESYS
+	fat_remove_chain (sector_to_cluster (sector), 0);
+#else
+	free_map_release (sector, 1);
+#endif
+}
+
 /* Opens the file with the given NAME.
  * Returns the new file if successful or a null pointer
  * otherwise.
@@ -110,6 +151,8 @@ do_format (void) {
 #ifdef EFILESYS
 	/* Create FAT and save it to the disk. */
 	fat_create ();
+	if (!dir_create (cluster_to_sector (ROOT_DIR_CLUSTER), 16))
+		PANIC ("root directory creation failed");
 	fat_close ();
 #else
 	free_map_create ();
@@ -4,10 +4,15 @@
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "threads/synch.h"
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per disk sector. */
 
+/* Protects the free map and its file, so that files grow without the
+ * file system lock. */
+static struct lock free_map_lock;
+
 /* Initializes the free map. */
 void
 free_map_init (void) {
@@ -16,6 +21,7 @@ free_map_init (void) {
 		PANIC ("bitmap creation failed--disk is too large");
 	bitmap_mark (free_map, FREE_MAP_SECTOR);
 	bitmap_mark (free_map, ROOT_DIR_SECTOR);
+	lock_init (&free_map_lock);
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
@@ -24,7 +30,20 @@ free_map_init (void) {
  * available. */
 bool
 free_map_allocate (size_t cnt, disk_sector_t *sectorp) {
-	disk_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
+	return free_map_allocate_near (cnt, 0, sectorp);
+}
+
+/* Like free_map_allocate (), but looks for the sectors at HINT and after
+ * it first. */
+bool
+free_map_allocate_near (size_t cnt, disk_sector_t hint,
+		disk_sector_t *sectorp) {
+	disk_sector_t sector;
+
+	lock_acquire (&free_map_lock);
+	sector = bitmap_scan_and_flip (free_map, hint, cnt, false);
+	if (sector == BITMAP_ERROR && hint != 0)
+		sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
 	if (sector != BITMAP_ERROR
 			&& free_map_file != NULL
 			&& !bitmap_write (free_map, free_map_file)) {
@@ -33,15 +52,39 @@ free_map_allocate (size_t cnt, disk_sector_t *sectorp) {
 	}
 	if (sector != BITMAP_ERROR)
 		*sectorp = sector;
+	lock_release (&free_map_lock);
 	return sector != BITMAP_ERROR;
 }
 
+/* Allocates the free sectors that follow each other from SECTOR on, up to
+ * CNT of them, and returns how many it allocated. */
+size_t
+free_map_extend (disk_sector_t sector, size_t cnt) {
+	size_t got = 0;
+
+	lock_acquire (&free_map_lock);
+	while (got < cnt && sector + got < bitmap_size (free_map)
+			&& !bitmap_test (free_map, sector + got))
+		got++;
+	if (got > 0) {
+		bitmap_set_multiple (free_map, sector, got, true);
+		if (free_map_file != NULL && !bitmap_write (free_map, free_map_file)) {
+			bitmap_set_multiple (free_map, sector, got, false);
+			got = 0;
+		}
+	}
+	lock_release (&free_map_lock);
+	return got;
+}
+
 /* Makes CNT sectors starting at SECTOR available for use. */
 void
 free_map_release (disk_sector_t sector, size_t cnt) {
+	lock_acquire (&free_map_lock);
 	ASSERT (bitmap_all (free_map, sector, cnt));
 	bitmap_set_multiple (free_map, sector, cnt, false);
 	bitmap_write (free_map, free_map_file);
+	lock_release (&free_map_lock);
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -1,23 +1,33 @@
 #include "filesys/inode.h"
+#include <hash.h>
 #include <list.h>
 #include <debug.h>
 #include <round.h>
 #include <string.h>
+#include "filesys/buffer_cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
+#ifdef EFILESYS
+#include "filesys/fat.h"
+#endif
+#ifdef VM
+#include "filesys/page_cache.h"
+#endif
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
-/* On-disk inode.
- * Must be exactly DISK_SECTOR_SIZE bytes long. */
-struct inode_disk {
-	disk_sector_t start;                /* First data sector. */
-	off_t length;                       /* File size in bytes. */
-	unsigned magic;                     /* Magic number. */
-	uint32_t unused[125];               /* Not used. */
-};
+/* Number of buckets of the open inode table, a power of 2. */
+#define INODE_BUCKETS 64
+
+/* Most freed inodes kept for reuse. */
+#define INODE_POOL_MAX 64
+
+struct inode;
+static struct inode *inode_alloc (void);
+static void inode_release (struct inode *);
 
 /* Returns the number of sectors to allocate for an inode SIZE
  * bytes long. */
@@ -26,37 +36,435 @@ bytes_to_sectors (off_t size) {
 	return DIV_ROUND_UP (size, DISK_SECTOR_SIZE);
 }
 
+#ifndef EFILESYS
+/* Number of extents held in the inode itself and in its overflow block. */
+#define INLINE_EXTENTS 41
+#define OVERFLOW_EXTENTS 42
+#define MAX_EXTENTS (INLINE_EXTENTS + OVERFLOW_EXTENTS)
+
+/* A run of consecutive disk sectors holding consecutive sectors of a
+ * file. */
+struct extent {
+	uint32_t ofs;                       /* First sector of the file held. */
+	disk_sector_t start;                /* First disk sector. */
+	uint32_t cnt;                       /* Number of sectors. */
+};
+
+/* On-disk inode.
+ * Must be exactly DISK_SECTOR_SIZE bytes long.
+ * A file's data is held by its extents, in file order; the ones that do
+ * not fit in the inode go in its overflow block. */
+struct inode_disk {
+	off_t length;                       /* File size in bytes. */
+	unsigned magic;                     /* Magic number. */
+	uint32_t extent_cnt;                /* Number of extents in use. */
+	disk_sector_t overflow;             /* Overflow block, 0 if none. */
+	struct extent extents[INLINE_EXTENTS]; /* First extents. */
+	uint32_t unused;                    /* Not used. */
+};
+
+/* Overflow block of an inode, holding its extents past INLINE_EXTENTS.
+ * Must be exactly DISK_SECTOR_SIZE bytes long. */
+struct overflow_disk {
+	struct extent extents[OVERFLOW_EXTENTS]; /* Further extents. */
+	uint32_t unused[2];                 /* Not used. */
+};
+
 /* In-memory inode. */
 struct inode {
-	struct list_elem elem;              /* Element in inode list. */
+	struct list_elem elem;              /* Element in its bucket or the pool. */
 	disk_sector_t sector;               /* Sector number of disk location. */
 	int open_cnt;                       /* Number of openers. */
 	bool removed;                       /* True if deleted, false otherwise. */
 	int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+	struct rwlock rwlock;               /* Serializes growth; see inode_extend. */
 	struct inode_disk data;             /* Inode content. */
+	struct overflow_disk *overflow;     /* Overflow block, if there is one. */
 };
 
+/* Returns extent I of INODE. */
+static struct extent *
+extent_at (const struct inode *inode, size_t i) {
+	ASSERT (i < inode->data.extent_cnt);
+	if (i < INLINE_EXTENTS)
+		return (struct extent *) &inode->data.extents[i];
+	return &inode->overflow->extents[i - INLINE_EXTENTS];
+}
+
+/* Returns the number of sectors allocated to INODE, which may be more
+ * than its length needs. */
+static size_t
+inode_sectors (const struct inode *inode) {
+	const struct extent *last;
+
+	if (inode->data.extent_cnt == 0)
+		return 0;
+	last = extent_at (inode, inode->data.extent_cnt - 1);
+	return last->ofs + last->cnt;
+}
+
 /* Returns the disk sector that contains byte offset POS within
  * INODE.
  * Returns -1 if INODE does not contain data for a byte at offset
  * POS. */
 static disk_sector_t
 byte_to_sector (const struct inode *inode, off_t pos) {
+	size_t lo = 0, hi = inode->data.extent_cnt;
+	uint32_t ofs = pos / DISK_SECTOR_SIZE;
+
 	ASSERT (inode != NULL);
-	if (pos < inode->data.length)
-		return inode->data.start + pos / DISK_SECTOR_SIZE;
-	else
+	if (pos >= inode->data.length)
 		return -1;
+
+	/* Binary search for the last extent starting at or before OFS. */
+	while (hi - lo > 1) {
+		size_t mid = (lo + hi) / 2;
+		if (extent_at (inode, mid)->ofs <= ofs)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	ASSERT (ofs - extent_at (inode, lo)->ofs < extent_at (inode, lo)->cnt);
+	return extent_at (inode, lo)->start + (ofs - extent_at (inode, lo)->ofs);
+}
+
+/* Writes INODE's on-disk inode and overflow block back to the disk. */
+static void
+inode_write_meta (struct inode *inode) {
+	buffer_cache_write (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+	if (inode->overflow != NULL)
+		buffer_cache_write (inode->data.overflow, inode->overflow, 0,
+				DISK_SECTOR_SIZE);
 }
 
-/* List of open inodes, so that opening a single inode twice
- * returns the same `struct inode'. */
-static struct list open_inodes;
+/* Appends CNT sectors from disk sector START to INODE's data, extending
+ * its last extent if START follows it.  Returns false if INODE has no
+ * room for another extent. */
+static bool
+extent_append (struct inode *inode, disk_sector_t start, size_t cnt) {
+	size_t ofs = inode_sectors (inode);
+	size_t n = inode->data.extent_cnt;
+	struct extent *ext;
+
+	if (n > 0) {
+		struct extent *last = extent_at (inode, n - 1);
+		if (last->start + last->cnt == start) {
+			last->cnt += cnt;
+			return true;
+		}
+	}
+
+	if (n == MAX_EXTENTS)
+		return false;
+	if (n == INLINE_EXTENTS && inode->overflow == NULL) {
+		struct overflow_disk *overflow = calloc (1, sizeof *overflow);
+
+		if (overflow == NULL)
+			return false;
+		if (!free_map_allocate_near (1, inode->sector,
+					&inode->data.overflow)) {
+			free (overflow);
+			return false;
+		}
+		inode->overflow = overflow;
+	}
+
+	/* The new extent is filled in before it is counted: readers that do
+	 * not hold the rwlock, on the eviction and writeback paths, must never
+	 * see a slot in use that holds garbage. */
+	ext = n < INLINE_EXTENTS ? &inode->data.extents[n]
+		: &inode->overflow->extents[n - INLINE_EXTENTS];
+	*ext = (struct extent) {
+		.ofs = ofs,
+		.start = start,
+		.cnt = cnt,
+	};
+	barrier ();
+	inode->data.extent_cnt++;
+	return true;
+}
+
+/* Allocates CNT more zeroed sectors to INODE.  The sectors following the
+ * last extent are taken first, so that the file stays in one piece as far
+ * as possible; after that, the largest runs to be found near it.  Returns
+ * false if the disk is full or the file too fragmented, in which case
+ * part of the sectors may have been allocated. */
+static bool
+inode_allocate (struct inode *inode, size_t cnt) {
+	static char zeros[DISK_SECTOR_SIZE];
+
+	while (cnt > 0) {
+		disk_sector_t start = inode->sector + 1;
+		size_t got = 0, i;
+
+		if (inode->data.extent_cnt > 0) {
+			struct extent *last = extent_at (inode,
+					inode->data.extent_cnt - 1);
+			start = last->start + last->cnt;
+			got = free_map_extend (start, cnt);
+		}
+		if (got == 0) {
+			for (got = cnt; !free_map_allocate_near (got, start, &start);
+					got /= 2)
+				if (got == 1)
+					return false;
+		}
+
+		for (i = 0; i < got; i++)
+			buffer_cache_write (start + i, zeros, 0, DISK_SECTOR_SIZE);
+		if (!extent_append (inode, start, got)) {
+			free_map_release (start, got);
+			return false;
+		}
+		cnt -= got;
+	}
+	return true;
+}
+
+/* Releases every sector of INODE's data and its overflow block. */
+static void
+inode_deallocate (struct inode *inode) {
+	size_t i;
+
+	for (i = 0; i < inode->data.extent_cnt; i++)
+		free_map_release (extent_at (inode, i)->start,
+				extent_at (inode, i)->cnt);
+	if (inode->overflow != NULL)
+		free_map_release (inode->data.overflow, 1);
+}
+
+/* Sets up the in-memory part of INODE's layout once its on-disk inode
+ * has been read.  Returns false if memory is short. */
+static bool
+inode_load (struct inode *inode) {
+	inode->overflow = NULL;
+	if (inode->data.extent_cnt > INLINE_EXTENTS) {
+		inode->overflow = malloc (sizeof *inode->overflow);
+		if (inode->overflow == NULL)
+			return false;
+		buffer_cache_read (inode->data.overflow, inode->overflow, 0,
+				DISK_SECTOR_SIZE);
+	}
+	return true;
+}
+
+/* Frees INODE, which is gone from the open inodes. */
+static void
+inode_free (struct inode *inode) {
+	free (inode->overflow);
+	inode_release (inode);
+}
+
+#else /* EFILESYS */
+/* On-disk inode.
+ * Must be exactly DISK_SECTOR_SIZE bytes long.
+ * A file's data is held by a chain of clusters in the FAT. */
+struct inode_disk {
+	cluster_t start;                    /* First data cluster, 0 if none. */
+	off_t length;                       /* File size in bytes. */
+	unsigned magic;                     /* Magic number. */
+	uint32_t unused[125];               /* Not used. */
+};
+
+/* In-memory inode. */
+struct inode {
+	struct list_elem elem;              /* Element in its bucket or the pool. */
+	disk_sector_t sector;               /* Sector number of disk location. */
+	int open_cnt;                       /* Number of openers. */
+	bool removed;                       /* True if deleted, false otherwise. */
+	int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+	struct rwlock rwlock;               /* Serializes growth; see inode_extend. */
+	struct inode_disk data;             /* Inode content. */
+	struct fat_chain chain;             /* Positions in the data's chain. */
+};
+
+/* Returns the number of sectors allocated to INODE: its length, rounded
+ * up to whole clusters. */
+static size_t
+inode_sectors (const struct inode *inode) {
+	return ROUND_UP (bytes_to_sectors (inode->data.length),
+			fat_cluster_sectors ());
+}
+
+/* Returns the disk sector that contains byte offset POS within
+ * INODE.
+ * Returns -1 if INODE does not contain data for a byte at offset
+ * POS. */
+static disk_sector_t
+byte_to_sector (const struct inode *inode, off_t pos) {
+	size_t ofs = pos / DISK_SECTOR_SIZE;
+	cluster_t clst;
+
+	ASSERT (inode != NULL);
+	if (pos >= inode->data.length)
+		return -1;
+
+	/* The chain cache is not part of what the inode holds, and has a lock
+	 * of its own: the eviction and writeback paths get here without
+	 * INODE's rwlock. */
+	clst = fat_chain_get ((struct fat_chain *) &inode->chain,
+			inode->data.start, ofs / fat_cluster_sectors ());
+	ASSERT (clst != 0);
+	return cluster_to_sector (clst) + ofs % fat_cluster_sectors ();
+}
+
+/* Writes INODE's on-disk inode back to the disk. */
+static void
+inode_write_meta (struct inode *inode) {
+	buffer_cache_write (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+}
+
+/* Appends zeroed clusters for CNT more sectors to INODE's chain.  The FAT
+ * allocates next-fit, so a file that grows by itself stays in one run.
+ * Returns false, with the chain as it was, if the disk is full. */
+static bool
+inode_allocate (struct inode *inode, size_t cnt) {
+	static char zeros[DISK_SECTOR_SIZE];
+	size_t have = inode_sectors (inode) / fat_cluster_sectors ();
+	cluster_t tail = have > 0
+		? fat_chain_get (&inode->chain, inode->data.start, have - 1) : 0;
+	cluster_t last = tail, first = 0;
+	size_t i, j;
+
+	for (i = 0; i < DIV_ROUND_UP (cnt, fat_cluster_sectors ()); i++) {
+		cluster_t clst = fat_create_chain (last);
+
+		if (clst == 0) {
+			if (first != 0)
+				fat_remove_chain (first, tail);
+			if (tail == 0)
+				inode->data.start = 0;
+			return false;
+		}
+		if (first == 0)
+			first = clst;
+		if (inode->data.start == 0)
+			inode->data.start = clst;
+		for (j = 0; j < fat_cluster_sectors (); j++)
+			buffer_cache_write (cluster_to_sector (clst) + j, zeros, 0,
+					DISK_SECTOR_SIZE);
+		last = clst;
+	}
+	return true;
+}
+
+/* Releases the chain of INODE's data. */
+static void
+inode_deallocate (struct inode *inode) {
+	if (inode->data.start != 0)
+		fat_remove_chain (inode->data.start, 0);
+}
+
+/* Sets up the in-memory part of INODE's layout once its on-disk inode
+ * has been read.  Returns false if memory is short. */
+static bool
+inode_load (struct inode *inode) {
+	fat_chain_init (&inode->chain);
+	return true;
+}
+
+/* Frees INODE, which is gone from the open inodes. */
+static void
+inode_free (struct inode *inode) {
+	fat_chain_destroy (&inode->chain);
+	inode_release (inode);
+}
+#endif /* EFILESYS */
+
+/* Grows INODE to LENGTH bytes, the new bytes reading as zeros.  Returns
+ * false, leaving its length as it was, if the sectors cannot be had.
+ * The caller must hold INODE's lock for writing.  Readers that do not
+ * hold it may look at the layout meanwhile, so new sectors are published
+ * before the length that covers them. */
+bool
+inode_extend (struct inode *inode, off_t length) {
+	size_t have = inode_sectors (inode);
+	size_t need = bytes_to_sectors (length);
+
+	if (length <= inode->data.length)
+		return true;
+	if (need > have && !inode_allocate (inode, need - have)) {
+		inode_write_meta (inode);
+		return false;
+	}
+#ifdef VM
+	page_cache_grow (inode, inode->data.length, length);
+#endif
+	/* The length goes last: byte_to_sector () looks only below it, so a
+	 * reader without the rwlock finds the new sectors only once they are
+	 * in place. */
+	barrier ();
+	inode->data.length = length;
+	inode_write_meta (inode);
+	return true;
+}
+
+/* Open inodes, hashed by sector, so that opening a single inode twice
+ * returns the same `struct inode'.  Each bucket's lock protects its list
+ * and the open counts of the inodes in it.  The last close of an inode
+ * writes it back with its bucket's lock held, so that it cannot be opened
+ * again half closed; bucket locks are taken before frame_lock and never
+ * two at once. */
+struct inode_bucket {
+	struct list inodes;                 /* Open inodes. */
+	struct lock lock;
+};
+static struct inode_bucket open_inodes[INODE_BUCKETS];
+
+/* Freed inodes, kept to be handed out again without going to the
+ * allocator.  Protected by pool_lock. */
+static struct list inode_pool;
+static size_t inode_pool_cnt;
+static struct lock pool_lock;
+
+/* Returns the bucket of the open inode table for SECTOR. */
+static struct inode_bucket *
+bucket_of (disk_sector_t sector) {
+	return &open_inodes[hash_int (sector) & (INODE_BUCKETS - 1)];
+}
+
+/* Returns a zeroed inode, or a null pointer if memory is short. */
+static struct inode *
+inode_alloc (void) {
+	struct inode *inode = NULL;
+
+	lock_acquire (&pool_lock);
+	if (!list_empty (&inode_pool)) {
+		inode = list_entry (list_pop_front (&inode_pool), struct inode, elem);
+		inode_pool_cnt--;
+	}
+	lock_release (&pool_lock);
+
+	if (inode == NULL)
+		return calloc (1, sizeof *inode);
+	memset (inode, 0, sizeof *inode);
+	return inode;
+}
+
+/* Gives back INODE, from inode_alloc (). */
+static void
+inode_release (struct inode *inode) {
+	lock_acquire (&pool_lock);
+	if (inode_pool_cnt < INODE_POOL_MAX) {
+		list_push_front (&inode_pool, &inode->elem);
+		inode_pool_cnt++;
+		inode = NULL;
+	}
+	lock_release (&pool_lock);
+	free (inode);
+}
 
 /* Initializes the inode module. */
 void
 inode_init (void) {
-	list_init (&open_inodes);
+	size_t i;
+
+	for (i = 0; i < INODE_BUCKETS; i++) {
+		list_init (&open_inodes[i].inodes);
+		lock_init (&open_inodes[i].lock);
+	}
+	list_init (&inode_pool);
+	lock_init (&pool_lock);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -66,33 +474,31 @@ inode_init (void) {
  * Returns false if memory or disk allocation fails. */
 bool
 inode_create (disk_sector_t sector, off_t length) {
-	struct inode_disk *disk_inode = NULL;
+	struct inode *inode = NULL;
 	bool success = false;
 
 	ASSERT (length >= 0);
 
 	/* If this assertion fails, the inode structure is not exactly
 	 * one sector in size, and you should fix that. */
-	ASSERT (sizeof *disk_inode == DISK_SECTOR_SIZE);
-
-	disk_inode = calloc (1, sizeof *disk_inode);
-	if (disk_inode != NULL) {
-		size_t sectors = bytes_to_sectors (length);
-		disk_inode->length = length;
-		disk_inode->magic = INODE_MAGIC;
-		if (free_map_allocate (sectors, &disk_inode->start)) {
-			disk_write (filesys_disk, sector, disk_inode);
-			if (sectors > 0) {
-				static char zeros[DISK_SECTOR_SIZE];
-				size_t i;
-
-				for (i = 0; i < sectors; i++) 
-					disk_write (filesys_disk, disk_inode->start + i, zeros); 
-			}
+	ASSERT (sizeof (struct inode_disk) == DISK_SECTOR_SIZE);
+#ifndef EFILESYS
+	ASSERT (sizeof (struct overflow_disk) == DISK_SECTOR_SIZE);
+#endif
+
+	inode = inode_alloc ();
+	if (inode != NULL && inode_load (inode)) {
+		inode->sector = sector;
+		inode->data.magic = INODE_MAGIC;
+		if (inode_allocate (inode, bytes_to_sectors (length))) {
+			inode->data.length = length;
+			inode_write_meta (inode);
 			success = true; 
-		} 
-		free (disk_inode);
-	}
+		} else
+			inode_deallocate (inode);
+		inode_free (inode);
+	} else if (inode != NULL)
+		inode_release (inode);
 	return success;
 }
 
@@ -101,39 +507,56 @@ inode_create (disk_sector_t sector, off_t length) {
  * Returns a null pointer if memory allocation fails. */
 struct inode *
 inode_open (disk_sector_t sector) {
+	struct inode_bucket *b = bucket_of (sector);
 	struct list_elem *e;
 	struct inode *inode;
 
+	lock_acquire (&b->lock);
+
 	/* Check whether this inode is already open. */
-	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
+	for (e = list_begin (&b->inodes); e != list_end (&b->inodes);
 			e = list_next (e)) {
 		inode = list_entry (e, struct inode, elem);
 		if (inode->sector == sector) {
-			inode_reopen (inode);
-			return inode; 
+			inode->open_cnt++;
+			goto done;
 		}
 	}
 
 	/* Allocate memory. */
-	inode = malloc (sizeof *inode);
+	inode = inode_alloc ();
 	if (inode == NULL)
-		return NULL;
+		goto done;
+	buffer_cache_read (sector, &inode->data, 0, DISK_SECTOR_SIZE);
+	if (!inode_load (inode)) {
+		inode_release (inode);
+		inode = NULL;
+		goto done;
+	}
 
 	/* Initialize. */
-	list_push_front (&open_inodes, &inode->elem);
+	list_push_front (&b->inodes, &inode->elem);
 	inode->sector = sector;
 	inode->open_cnt = 1;
 	inode->deny_write_cnt = 0;
 	inode->removed = false;
-	disk_read (filesys_disk, inode->sector, &inode->data);
+	rwlock_init (&inode->rwlock);
+
+done:
+	lock_release (&b->lock);
 	return inode;
 }
 
 /* Reopens and returns INODE. */
 struct inode *
 inode_reopen (struct inode *inode) {
-	if (inode != NULL)
+	if (inode != NULL) {
+		struct inode_bucket *b = bucket_of (inode->sector);
+
+		lock_acquire (&b->lock);
 		inode->open_cnt++;
+		lock_release (&b->lock);
+	}
 	return inode;
 }
 
@@ -148,24 +571,34 @@ inode_get_inumber (const struct inode *inode) {
  * If INODE was also a removed inode, frees its blocks. */
 void
 inode_close (struct inode *inode) {
+	struct inode_bucket *b;
+
 	/* Ignore null pointer. */
 	if (inode == NULL)
 		return;
 
+	b = bucket_of (inode->sector);
+	lock_acquire (&b->lock);
+
 	/* Release resources if this was the last opener. */
 	if (--inode->open_cnt == 0) {
-		/* Remove from inode list and release lock. */
+		/* Remove from its bucket. */
 		list_remove (&inode->elem);
 
+#ifdef VM
+		/* The pages of a removed file need not reach the disk. */
+		page_cache_drop (inode, !inode->removed);
+#endif
+
 		/* Deallocate blocks if removed. */
 		if (inode->removed) {
-			free_map_release (inode->sector, 1);
-			free_map_release (inode->data.start,
-					bytes_to_sectors (inode->data.length)); 
+			filesys_free_inode (inode->sector);
+			inode_deallocate (inode);
 		}
 
-		free (inode); 
+		inode_free (inode);
 	}
+	lock_release (&b->lock);
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -178,16 +611,37 @@ inode_remove (struct inode *inode) {
 
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
  * Returns the number of bytes actually read, which may be less
- * than SIZE if an error occurs or end of file is reached. */
+ * than SIZE if an error occurs or end of file is reached.
+ * With virtual memory, file data goes through the page cache.
+ * Readers share INODE's lock. */
 off_t
-inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
+inode_read_at (struct inode *inode, void *buffer, off_t size, off_t offset) {
+	off_t bytes_read;
+
+	rwlock_acquire_read (&inode->rwlock);
+#ifdef VM
+	if (page_cache_enabled ())
+		bytes_read = page_cache_read (inode, buffer, size, offset);
+	else
+#endif
+		bytes_read = inode_read_disk (inode, buffer, size, offset);
+	rwlock_release_read (&inode->rwlock);
+	return bytes_read;
+}
+
+/* Like inode_read_at (), but reads from the disk, through the buffer
+ * cache.  The page cache's eviction and writeback paths call this and
+ * inode_write_disk () without INODE's lock, holding frame_lock; they rely
+ * on the length only growing, and only once the sectors below it are in
+ * place (see inode_extend ()). */
+off_t
+inode_read_disk (struct inode *inode, void *buffer_, off_t size,
+		off_t offset) {
 	uint8_t *buffer = buffer_;
 	off_t bytes_read = 0;
-	uint8_t *bounce = NULL;
 
 	while (size > 0) {
-		/* Disk sector to read, starting byte offset within sector. */
-		disk_sector_t sector_idx = byte_to_sector (inode, offset);
+		/* Starting byte offset within sector. */
 		int sector_ofs = offset % DISK_SECTOR_SIZE;
 
 		/* Bytes left in inode, bytes left in sector, lesser of the two. */
@@ -200,49 +654,72 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 		if (chunk_size <= 0)
 			break;
 
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Read full sector directly into caller's buffer. */
-			disk_read (filesys_disk, sector_idx, buffer + bytes_read); 
-		} else {
-			/* Read sector into bounce buffer, then partially copy
-			 * into caller's buffer. */
-			if (bounce == NULL) {
-				bounce = malloc (DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
-			}
-			disk_read (filesys_disk, sector_idx, bounce);
-			memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
-		}
+		/* Disk sector to read, looked up only below the length read
+		 * above, which a concurrent extension may have raised since. */
+		buffer_cache_read (byte_to_sector (inode, offset),
+				buffer + bytes_read, sector_ofs, chunk_size);
 
 		/* Advance. */
 		size -= chunk_size;
 		offset += chunk_size;
 		bytes_read += chunk_size;
 	}
-	free (bounce);
 
 	return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
  * Returns the number of bytes actually written, which may be
- * less than SIZE if end of file is reached or an error occurs.
- * (Normally a write at end of file would extend the inode, but
- * growth is not yet implemented.) */
+ * less than SIZE if the disk fills up or an error occurs.
+ * A write past the end of file extends the inode first, holding its
+ * lock exclusively while it does.  The data is then copied with the
+ * lock shared, like other writes, so that writes to different parts of
+ * a file proceed in parallel and a fault on BUFFER may read the file.
+ * With virtual memory, file data goes through the page cache.
+ *
+ * Writes exclude each other and reads one page of the file at a time
+ * with virtual memory, one sector at a time without: the page cache and
+ * the buffer cache lock what is copied in or out.  A read overlapping a
+ * write thus sees each such part of it whole, before or after it, and
+ * overlapping writes leave each part as one of them wrote it, though a
+ * write spanning several parts is not atomic as a whole. */
 off_t
-inode_write_at (struct inode *inode, const void *buffer_, off_t size,
+inode_write_at (struct inode *inode, const void *buffer, off_t size,
 		off_t offset) {
-	const uint8_t *buffer = buffer_;
-	off_t bytes_written = 0;
-	uint8_t *bounce = NULL;
+	off_t bytes_written;
 
 	if (inode->deny_write_cnt)
 		return 0;
+	if (size > 0 && offset + size > inode_length (inode)) {
+		rwlock_acquire_write (&inode->rwlock);
+		inode_extend (inode, offset + size);
+		rwlock_release_write (&inode->rwlock);
+	}
+
+	rwlock_acquire_read (&inode->rwlock);
+	/* Write what fits. */
+	if (offset >= inode_length (inode))
+		bytes_written = 0;
+#ifdef VM
+	else if (page_cache_enabled ())
+		bytes_written = page_cache_write (inode, buffer, size, offset);
+#endif
+	else
+		bytes_written = inode_write_disk (inode, buffer, size, offset);
+	rwlock_release_read (&inode->rwlock);
+	return bytes_written;
+}
+
+/* Like inode_write_at (), but writes to the disk, through the buffer
+ * cache, even while writes to INODE are denied. */
+off_t
+inode_write_disk (struct inode *inode, const void *buffer_, off_t size,
+		off_t offset) {
+	const uint8_t *buffer = buffer_;
+	off_t bytes_written = 0;
 
 	while (size > 0) {
-		/* Sector to write, starting byte offset within sector. */
-		disk_sector_t sector_idx = byte_to_sector (inode, offset);
+		/* Starting byte offset within sector. */
 		int sector_ofs = offset % DISK_SECTOR_SIZE;
 
 		/* Bytes left in inode, bytes left in sector, lesser of the two. */
@@ -255,38 +732,31 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 		if (chunk_size <= 0)
 			break;
 
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Write full sector directly to disk. */
-			disk_write (filesys_disk, sector_idx, buffer + bytes_written); 
-		} else {
-			/* We need a bounce buffer. */
-			if (bounce == NULL) {
-				bounce = malloc (DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
-			}
-
-			/* If the sector contains data before or after the chunk
-			   we're writing, then we need to read in the sector
-			   first.  Otherwise we start with a sector of all zeros. */
-			if (sector_ofs > 0 || chunk_size < sector_left) 
-				disk_read (filesys_disk, sector_idx, bounce);
-			else
-				memset (bounce, 0, DISK_SECTOR_SIZE);
-			memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-			disk_write (filesys_disk, sector_idx, bounce); 
-		}
+		/* Sector to write, looked up as in inode_read_disk (). */
+		buffer_cache_write (byte_to_sector (inode, offset),
+				buffer + bytes_written, sector_ofs, chunk_size);
 
 		/* Advance. */
 		size -= chunk_size;
 		offset += chunk_size;
 		bytes_written += chunk_size;
 	}
-	free (bounce);
 
 	return bytes_written;
 }
 
+/* Has the sectors of INODE from OFFSET up to OFFSET + SIZE read into the
+ * buffer cache in the background, as far as the file goes. */
+void
+inode_readahead (struct inode *inode, off_t offset, off_t size) {
+	off_t end = offset + size < inode_length (inode)
+		? offset + size : inode_length (inode);
+
+	offset = ROUND_DOWN (offset, DISK_SECTOR_SIZE);
+	for (; offset < end; offset += DISK_SECTOR_SIZE)
+		buffer_cache_readahead (byte_to_sector (inode, offset));
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 	void
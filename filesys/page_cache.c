@@ -1,6 +1,25 @@
 /* page_cache.c: Implementation of Page Cache (Buffer Cache). */
 
+#include "filesys/page_cache.h"
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall-nr.h>
 #include "vm/vm.h"
+
+#ifdef VM
+#include <stdlib.h>
+#include "devices/timer.h"
+#include "filesys/buffer_cache.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
 static bool page_cache_readahead (struct page *page, void *kva);
 static bool page_cache_writeback (struct page *page);
 static void page_cache_destroy (struct page *page);
@@ -15,36 +34,836 @@ static const struct page_operations page_cache_op = {
 
 tid_t page_cache_workerd;
 
+/* Ticks between two runs of the writeback daemon. */
+#define WRITEBACK_INTERVAL (TIMER_FREQ / 2)
+
+/* Ticks a page may stay dirty before the writeback daemon writes it. */
+#define DIRTY_EXPIRE (3 * TIMER_FREQ)
+
+/* Percentage of the user pool that may be dirty in the cache before
+ * writers have to write back pages themselves. */
+#define DIRTY_RATIO 10
+
+/* Dirty pages written back per hold of frame_lock. */
+#define WRITEBACK_BATCH 16
+
+/* Largest file offset. */
+#define OFS_MAX INT32_MAX
+
+/* The cached pages of one open inode, keyed by offset.  Kept while any of
+ * its pages is in the cache or one is being looked up. */
+struct cached_inode {
+	struct hash_elem elem;      /* Element in `inodes'. */
+	struct inode *inode;        /* The inode. */
+	struct hash pages;          /* Cache pages, by offset. */
+	int pin_cnt;                /* Lookups and pins in progress. */
+};
+
+/* Inodes with pages in the cache.  Protected by frame_lock, as are the
+ * cache pages and the frames holding them. */
+static struct hash inodes;
+static hash_hash_func cached_inode_hash;
+static hash_less_func cached_inode_less;
+static hash_hash_func cache_page_hash;
+static hash_less_func cache_page_less;
+
+/* Signaled whenever some inode's last pin goes away. */
+static struct condition unpinned;
+
+/* Signaled whenever the last copy to or from some cache page ends. */
+static struct condition copied;
+
+/* Reads and writes bypass the cache until it is set up. */
+static bool enabled;
+
+/* Pages in the cache, and how many of them are known to be dirty.
+ * Protected by frame_lock. */
+static size_t cached_cnt;
+static size_t dirty_cnt;
+
+struct page_cache_stats page_cache_stats;
+
+static void page_cache_kworkerd (void *aux);
+static void balance_dirty (struct inode *inode);
+
 /* The initializer of file vm */
 void
 pagecache_init (void) {
-	/* TODO: Create a worker daemon for page cache with page_cache_kworkerd */
+	hash_init (&inodes, cached_inode_hash, cached_inode_less, NULL);
+	cond_init (&unpinned);
+	cond_init (&copied);
+	enabled = true;
+
+	page_cache_workerd = thread_create ("page_cache_kworkerd", PRI_DEFAULT,
+			page_cache_kworkerd, NULL);
+}
+
+/* Returns true once file data goes through the page cache. */
+bool
+page_cache_enabled (void) {
+	return enabled;
 }
 
 /* Initialize the page cache */
 bool
-page_cache_initializer (struct page *page, enum vm_type type, void *kva) {
+page_cache_initializer (struct page *page, enum vm_type type UNUSED,
+		void *kva UNUSED) {
 	/* Set up the handler */
 	page->operations = &page_cache_op;
 
+	page->va = NULL;
+	page->frame = NULL;
+	page->spt = NULL;
+	page->pml4 = NULL;
+	page->writable = false;
+	page->vma = NULL;
+	page->page_cache.owner = NULL;
+	page->page_cache.ofs = 0;
+	page->page_cache.dirty = false;
+	page->page_cache.dirtied = 0;
+	page->page_cache.accessed = false;
+	page->page_cache.copiers = 0;
+	return true;
+}
+
+/* Returns the cached pages of INODE, or NULL if none are cached.  Must be
+ * called with frame_lock held. */
+static struct cached_inode *
+cached_inode_find (struct inode *inode) {
+	struct cached_inode key;
+	struct hash_elem *e;
+
+	key.inode = inode;
+	e = hash_find (&inodes, &key.elem);
+	return e != NULL ? hash_entry (e, struct cached_inode, elem) : NULL;
+}
+
+/* Returns the cached pages of INODE with one more pin, setting them up if
+ * there are none yet.  Returns NULL if memory is short.  Must be called
+ * with frame_lock held. */
+static struct cached_inode *
+cached_inode_get (struct inode *inode) {
+	struct cached_inode *ci = cached_inode_find (inode);
+
+	if (ci == NULL) {
+		ci = malloc (sizeof *ci);
+		if (ci == NULL)
+			return NULL;
+		ci->inode = inode;
+		ci->pin_cnt = 0;
+		if (!hash_init (&ci->pages, cache_page_hash, cache_page_less, NULL)) {
+			free (ci);
+			return NULL;
+		}
+		hash_insert (&inodes, &ci->elem);
+	}
+	ci->pin_cnt++;
+	return ci;
+}
+
+/* Frees CI if it holds no pages and nobody has it pinned.  Must be called
+ * with frame_lock held. */
+static void
+cached_inode_release (struct cached_inode *ci) {
+	if (ci->pin_cnt == 0 && hash_empty (&ci->pages)) {
+		hash_delete (&inodes, &ci->elem);
+		hash_destroy (&ci->pages, NULL);
+		free (ci);
+	}
+}
+
+/* Drops one pin of CI.  Must be called with frame_lock held. */
+static void
+cached_inode_put (struct cached_inode *ci) {
+	ASSERT (ci->pin_cnt > 0);
+
+	if (--ci->pin_cnt == 0) {
+		cond_broadcast (&unpinned, &frame_lock);
+		cached_inode_release (ci);
+	}
+}
+
+/* Returns the cache page at OFS in CI, or NULL.  Must be called with
+ * frame_lock held. */
+static struct page *
+cache_page_find (struct cached_inode *ci, off_t ofs) {
+	struct page key;
+	struct hash_elem *e;
+
+	key.page_cache.ofs = ofs;
+	e = hash_find (&ci->pages, &key.page_cache.elem);
+	return e != NULL ? hash_entry (e, struct page, page_cache.elem) : NULL;
+}
+
+/* Returns the cache page at OFS in CI, like cache_page_find (), but first
+ * waits for the evictor if it is writing the page out: the page is gone
+ * from the cache then, and NULL is returned.  CI must be pinned.  Must be
+ * called with frame_lock held. */
+static struct page *
+cache_page_lookup (struct cached_inode *ci, off_t ofs) {
+	struct page *page;
+
+	while ((page = cache_page_find (ci, ofs)) != NULL && page->frame->evicting)
+		cond_wait (&frame_evicted, &frame_lock);
+	return page;
+}
+
+/* Pins the frame of PAGE, whose owner the caller already pinned, and
+ * returns it.  Must be called with frame_lock held. */
+static struct frame *
+cache_page_pin (struct page *page) {
+	page->frame->pin_cnt++;
+	page->page_cache.accessed = true;
+	return page->frame;
+}
+
+/* Marks cache PAGE dirty, remembering when it became so.  Must be called
+ * with frame_lock held. */
+void
+page_cache_mark_dirty (struct page *page) {
+	struct page_cache *pc = &page->page_cache;
+
+	if (!pc->dirty) {
+		pc->dirty = true;
+		pc->dirtied = timer_ticks ();
+		dirty_cnt++;
+	}
+}
+
+/* Marks cache PAGE clean.  Must be called with frame_lock held. */
+static void
+mark_clean (struct page *page) {
+	if (page->page_cache.dirty) {
+		page->page_cache.dirty = false;
+		dirty_cnt--;
+	}
+}
+
+/* Marks PAGE clean after it has been written back, if it was dirty.  Must
+ * be called with frame_lock held. */
+static void
+cache_page_written (struct page *page) {
+	if (page->page_cache.dirty) {
+		mark_clean (page);
+		page_cache_stats.written++;
+		page_cache_stats.runs++;
+	}
+}
+
+/* Removes PAGE, whose frame is already gone, from the cache and frees it.
+ * Must be called with frame_lock held. */
+static void
+cache_page_forget (struct page *page) {
+	struct cached_inode *ci = page->page_cache.owner;
+
+	ASSERT (page->frame == NULL);
+	ASSERT (!page->page_cache.dirty);
+
+	hash_delete (&ci->pages, &page->page_cache.elem);
+	cached_cnt--;
+	free (page);
+	cached_inode_release (ci);
+}
+
+/* Does the work of page_cache_put () with frame_lock held. */
+static void
+cache_page_put (struct frame *frame, bool dirty) {
+	struct page *page = frame->cache;
+
+	ASSERT (frame->pin_cnt > 0);
+	if (dirty)
+		page_cache_mark_dirty (page);
+	frame->pin_cnt--;
+	cached_inode_put (page->page_cache.owner);
+}
+
+/* Writes PAGE to its file.  The file does not grow: bytes past its end
+ * stay in memory only. */
+static void
+cache_page_write (struct page *page) {
+	struct page_cache *pc = &page->page_cache;
+
+	inode_write_disk (pc->owner->inode, page->frame->kva, PGSIZE, pc->ofs);
+}
+
+/* Returns the frame holding the page at OFS, which must be page-aligned,
+ * of INODE, reading it in first if it is not cached.  The frame comes back
+ * pinned: the caller may read and write it without frame_lock and must
+ * release it with page_cache_put ().  A frame for a page not yet cached is
+ * allocated like one for SPT, which may be null; unless EVICT, only a free
+ * frame is used.  Returns NULL if no frame is to be had. */
+struct frame *
+page_cache_get (struct inode *inode, off_t ofs,
+		struct supplemental_page_table *spt, bool evict) {
+	struct cached_inode *ci;
+	struct page *page, *cached;
+	struct frame *frame = NULL;
+
+	ASSERT (ofs % PGSIZE == 0);
+
+	lock_acquire (&frame_lock);
+	ci = cached_inode_get (inode);
+	cached = ci != NULL ? cache_page_lookup (ci, ofs) : NULL;
+	if (cached != NULL) {
+		page_cache_stats.hits++;
+		frame = cache_page_pin (cached);
+	}
+	lock_release (&frame_lock);
+	if (ci == NULL || cached != NULL)
+		return ci != NULL ? frame : NULL;
+
+	/* Read the page without the lock; the pin keeps CI around. */
+	frame = vm_alloc_frame (spt, evict);
+	page = frame != NULL ? malloc (sizeof *page) : NULL;
+	if (page != NULL) {
+		page_cache_initializer (page, VM_PAGE_CACHE, frame->kva);
+		page->page_cache.owner = ci;
+		page->page_cache.ofs = ofs;
+		swap_in (page, frame->kva);
+	}
+
+	lock_acquire (&frame_lock);
+	if (page == NULL)
+		cached_inode_put (ci);
+	else if ((cached = cache_page_lookup (ci, ofs)) == NULL) {
+		/* The frame enters the frame table only once it is filled, so the
+		 * clock never picks a frame that is still being read. */
+		page_cache_stats.misses++;
+		hash_insert (&ci->pages, &page->page_cache.elem);
+		cached_cnt++;
+		page->frame = frame;
+		frame->page = NULL;
+		frame->cache = page;
+		list_push_back (&frame_table, &frame->elem);
+		cached = page;
+		page = NULL;
+		frame = NULL;
+	} else
+		page_cache_stats.hits++;
+	if (cached != NULL)
+		cache_page_pin (cached);
+	lock_release (&frame_lock);
+
+	/* Another thread read the same page in the meantime. */
+	free (page);
+	if (frame != NULL)
+		vm_discard_frame (frame);
+	return cached != NULL ? cached->frame : NULL;
+}
+
+/* Releases FRAME, pinned by page_cache_get ().  If DIRTY, the caller
+ * changed its contents and the page will be written back. */
+void
+page_cache_put (struct frame *frame, bool dirty) {
+	lock_acquire (&frame_lock);
+	cache_page_put (frame, dirty);
+	lock_release (&frame_lock);
+}
+
+/* Waits until the cache page in FRAME, which the caller has pinned, may be
+ * copied into, if WRITE, or out of, and claims it for that.  A copy into a
+ * page excludes every other copy to or from it, so that reads see the part
+ * of a write that falls in a page whole or not at all, and overlapping
+ * writes do not interleave within a page.  Copies out of a page share it:
+ * one may fault on its user buffer and read the same page of a file into
+ * it. */
+static void
+copy_begin (struct frame *frame, bool write) {
+	struct page_cache *pc = &frame->cache->page_cache;
+
+	lock_acquire (&frame_lock);
+	while (write ? pc->copiers != 0 : pc->copiers < 0)
+		cond_wait (&copied, &frame_lock);
+	pc->copiers = write ? -1 : pc->copiers + 1;
+	lock_release (&frame_lock);
+}
+
+/* Ends the copy into, if WRITE, or out of the page in FRAME that
+ * copy_begin () claimed, and releases the frame like page_cache_put ().
+ * If WRITE, the page will be written back. */
+static void
+copy_end (struct frame *frame, bool write) {
+	struct page_cache *pc = &frame->cache->page_cache;
+
+	lock_acquire (&frame_lock);
+	pc->copiers = write ? 0 : pc->copiers - 1;
+	if (pc->copiers == 0)
+		cond_broadcast (&copied, &frame_lock);
+	cache_page_put (frame, write);
+	lock_release (&frame_lock);
+}
+
+/* Reads SIZE bytes from INODE into BUFFER, starting at OFFSET, through the
+ * page cache.  Returns the number of bytes read, which is short at the end
+ * of the file or if no frame is to be had. */
+off_t
+page_cache_read (struct inode *inode, void *buffer_, off_t size,
+		off_t offset) {
+	uint8_t *buffer = buffer_;
+	off_t length = inode_length (inode);
+	off_t bytes_read = 0;
+
+	if (offset >= length)
+		return 0;
+	if (size > length - offset)
+		size = length - offset;
+
+	while (size > 0) {
+		int page_ofs = offset % PGSIZE;
+		int chunk_size = PGSIZE - page_ofs < size ? PGSIZE - page_ofs : size;
+		struct frame *frame = page_cache_get (inode, offset - page_ofs, NULL,
+				true);
+
+		if (frame == NULL)
+			break;
+		/* May fault on a user buffer, so no lock is held. */
+		copy_begin (frame, false);
+		memcpy (buffer + bytes_read, (uint8_t *) frame->kva + page_ofs,
+				chunk_size);
+		copy_end (frame, false);
+
+		size -= chunk_size;
+		offset += chunk_size;
+		bytes_read += chunk_size;
+	}
+	return bytes_read;
+}
+
+/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET, through the
+ * page cache.  The pages written reach the disk later, by writeback, unless
+ * too much of the cache is dirty already: then the writer writes back
+ * pages of INODE itself before it returns.
+ * Returns the number of bytes written, which is short at the end of the
+ * file or if no frame is to be had. */
+off_t
+page_cache_write (struct inode *inode, const void *buffer_, off_t size,
+		off_t offset) {
+	const uint8_t *buffer = buffer_;
+	off_t length = inode_length (inode);
+	off_t bytes_written = 0;
+
+	if (offset >= length)
+		return 0;
+	if (size > length - offset)
+		size = length - offset;
+
+	while (size > 0) {
+		int page_ofs = offset % PGSIZE;
+		int chunk_size = PGSIZE - page_ofs < size ? PGSIZE - page_ofs : size;
+		struct frame *frame = page_cache_get (inode, offset - page_ofs, NULL,
+				true);
+
+		if (frame == NULL)
+			break;
+		copy_begin (frame, true);
+		memcpy ((uint8_t *) frame->kva + page_ofs, buffer + bytes_written,
+				chunk_size);
+		copy_end (frame, true);
+
+		size -= chunk_size;
+		offset += chunk_size;
+		bytes_written += chunk_size;
+	}
+	balance_dirty (inode);
+	return bytes_written;
+}
+
+/* Clears what the cached page PAGE holds past the end of a file of
+ * LENGTH bytes.  Must be called with frame_lock held. */
+static void
+cache_page_clear_past (struct page *page, off_t length) {
+	off_t ofs = page->page_cache.ofs;
+	int start = ofs < length ? length - ofs : 0;
+
+	if (start < PGSIZE)
+		memset ((uint8_t *) page->frame->kva + start, 0, PGSIZE - start);
+}
+
+/* Clears what the cached pages of INODE, which is about to grow from
+ * OLD_LENGTH to NEW_LENGTH bytes, hold between the two: the tail of the
+ * page holding the old end, and each page wholly past it.  A mapping may
+ * have written there, but those bytes never became part of the file and
+ * must not now.  Pages being evicted are cleared as well: the evictor
+ * copies a page to disk only up to the length it finds, so either not
+ * past OLD_LENGTH or after this. */
+void
+page_cache_grow (struct inode *inode, off_t old_length, off_t new_length) {
+	struct cached_inode *ci;
+	off_t first = old_length - old_length % PGSIZE;
+	size_t range = DIV_ROUND_UP (new_length - first, PGSIZE);
+
+	if (!enabled || new_length <= old_length)
+		return;
+
+	lock_acquire (&frame_lock);
+	ci = cached_inode_find (inode);
+	if (ci != NULL && range > hash_size (&ci->pages)) {
+		/* A large extension: fewer pages cached than it covers. */
+		struct hash_iterator i;
+
+		hash_first (&i, &ci->pages);
+		while (hash_next (&i)) {
+			struct page *page = hash_entry (hash_cur (&i), struct page,
+					page_cache.elem);
+
+			if (page->page_cache.ofs >= first
+					&& page->page_cache.ofs < new_length)
+				cache_page_clear_past (page, old_length);
+		}
+	} else if (ci != NULL) {
+		off_t ofs;
+
+		for (ofs = first; ofs < new_length; ofs += PGSIZE) {
+			struct page *page = cache_page_find (ci, ofs);
+
+			if (page != NULL)
+				cache_page_clear_past (page, old_length);
+		}
+	}
+	lock_release (&frame_lock);
+}
+
+/* Starts evicting the cache page in FRAME, which the clock picked and
+ * took out of the frame table: unmaps it from every process, gathering
+ * their dirty bits, and pins its inode so that the page stays in the cache
+ * while the evictor writes it back without frame_lock.  Lookups of the
+ * page wait until page_cache_evict_end () has removed it.  Must be called
+ * with frame_lock held. */
+void
+page_cache_evict (struct frame *frame) {
+	struct page *page = frame->cache;
+
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+	ASSERT (frame->pin_cnt == 0);
+
+	while (!list_empty (&frame->pages))
+		vm_unlink_page (list_entry (list_front (&frame->pages), struct page,
+					frame_elem));
+	page->page_cache.owner->pin_cnt++;
+}
+
+/* Removes the cache page in FRAME, written back after page_cache_evict (),
+ * from the cache.  Must be called with frame_lock held. */
+void
+page_cache_evict_end (struct frame *frame) {
+	struct page *page = frame->cache;
+	struct cached_inode *ci = page->page_cache.owner;
+
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	cache_page_written (page);
+	page->frame = NULL;
+	frame->cache = NULL;
+	cache_page_forget (page);
+	cached_inode_put (ci);
+}
+
+/* Frees the cache page that E belongs to, pinned and written back by
+ * page_cache_drop (), returning its frame to the user pool.  Nothing maps
+ * it: its inode is being closed for good.  Must be called with frame_lock
+ * held. */
+static void
+cache_page_drop (struct hash_elem *e, void *aux UNUSED) {
+	struct page *page = hash_entry (e, struct page, page_cache.elem);
+	struct frame *frame = page->frame;
+
+	cache_page_written (page);
+	frame->pin_cnt--;
+	frame->cache = NULL;
+	vm_free_frame (frame);
+	cached_cnt--;
+	free (page);
+}
+
+/* Removes every page of INODE, whose last opener is closing it, from the
+ * cache, writing the dirty ones back first if WRITE_BACK.  Waits for
+ * writeback in progress on INODE to finish.  The pages are taken out of
+ * the cache's reach and pinned under frame_lock, then written back without
+ * it, like writeback () does, so that closing a file with many dirty pages
+ * holds up no faults or evictions. */
+void
+page_cache_drop (struct inode *inode, bool write_back) {
+	struct cached_inode *ci;
+	struct hash_iterator i;
+
+	if (!enabled)
+		return;
+
+	lock_acquire (&frame_lock);
+	while ((ci = cached_inode_find (inode)) != NULL && ci->pin_cnt > 0)
+		cond_wait (&unpinned, &frame_lock);
+	if (ci == NULL) {
+		lock_release (&frame_lock);
+		return;
+	}
+	hash_delete (&inodes, &ci->elem);
+	hash_first (&i, &ci->pages);
+	while (hash_next (&i)) {
+		struct page *page = hash_entry (hash_cur (&i), struct page,
+				page_cache.elem);
+
+		page->frame->pin_cnt++;
+		if (!write_back)
+			mark_clean (page);
+	}
+	lock_release (&frame_lock);
+
+	/* No lookup finds CI anymore, and the clock passes over its frames. */
+	hash_first (&i, &ci->pages);
+	while (hash_next (&i))
+		page_cache_writeback (hash_entry (hash_cur (&i), struct page,
+					page_cache.elem));
+
+	lock_acquire (&frame_lock);
+	hash_destroy (&ci->pages, cache_page_drop);
+	lock_release (&frame_lock);
+	free (ci);
+}
+
+/* Moves the dirty bits of the pages mapping PAGE's frame into PAGE, and
+ * returns true if PAGE is dirty.  Must be called with frame_lock held. */
+static bool
+cache_page_collect_dirty (struct page *page) {
+	struct list_elem *e;
+
+	for (e = list_begin (&page->frame->pages);
+			e != list_end (&page->frame->pages); e = list_next (e)) {
+		struct page *mapping = list_entry (e, struct page, frame_elem);
+
+		if (pml4_is_dirty (mapping->pml4, mapping->va)) {
+			pml4_set_dirty (mapping->pml4, mapping->va, false);
+			page_cache_mark_dirty (page);
+		}
+	}
+	return page->page_cache.dirty;
+}
+
+/* Adds to PAGES, which holds FOUND pages, the pages of CI at offsets from
+ * START up to END that have been dirty since tick OLDER or earlier, until
+ * PAGES holds CNT.  The pages added are pinned and marked clean.  Returns
+ * the number of pages in PAGES.  Must be called with frame_lock held. */
+static size_t
+collect_dirty (struct cached_inode *ci, off_t start, off_t end,
+		int64_t older, struct page *pages[], size_t found, size_t cnt) {
+	struct hash_iterator i;
+
+	hash_first (&i, &ci->pages);
+	while (found < cnt && hash_next (&i)) {
+		struct page *page = hash_entry (hash_cur (&i), struct page,
+				page_cache.elem);
+		struct page_cache *pc = &page->page_cache;
+
+		if (pc->ofs < start || pc->ofs >= end || page->frame->evicting
+				|| !cache_page_collect_dirty (page) || pc->dirtied > older)
+			continue;
+		mark_clean (page);
+		ci->pin_cnt++;
+		page->frame->pin_cnt++;
+		pages[found++] = page;
+	}
+	return found;
+}
+
+/* Orders cache pages by inode, then by offset, for qsort (). */
+static int
+page_order (const void *a_, const void *b_) {
+	const struct page_cache *a = &(*(struct page * const *) a_)->page_cache;
+	const struct page_cache *b = &(*(struct page * const *) b_)->page_cache;
+
+	if (a->owner != b->owner)
+		return a->owner < b->owner ? -1 : 1;
+	return a->ofs < b->ofs ? -1 : a->ofs > b->ofs;
+}
+
+/* Writes back the dirty pages of INODE, or of every inode if INODE is
+ * null, at offsets from START up to END that have been dirty since tick
+ * OLDER or earlier, stopping after MAX pages.  Each batch goes out in file
+ * order, so that a run of contiguous dirty pages becomes one sequential
+ * stream of sector writes.  The pages are pinned, not locked, while they
+ * are written: processes keep reading and writing them, and whatever they
+ * change meanwhile is dirty again.  Returns the number of pages written. */
+static size_t
+writeback (struct inode *inode, off_t start, off_t end, int64_t older,
+		size_t max) {
+	struct page *pages[WRITEBACK_BATCH];
+	size_t want, cnt, runs, total = 0, i;
+
+	do {
+		want = max - total < WRITEBACK_BATCH ? max - total : WRITEBACK_BATCH;
+		cnt = 0;
+
+		lock_acquire (&frame_lock);
+		if (inode != NULL) {
+			struct cached_inode *ci = cached_inode_find (inode);
+
+			if (ci != NULL)
+				cnt = collect_dirty (ci, start, end, older, pages, 0, want);
+		} else {
+			struct hash_iterator it;
+
+			hash_first (&it, &inodes);
+			while (cnt < want && hash_next (&it))
+				cnt = collect_dirty (hash_entry (hash_cur (&it),
+							struct cached_inode, elem),
+						start, end, older, pages, cnt, want);
+		}
+		lock_release (&frame_lock);
+
+		qsort (pages, cnt, sizeof *pages, page_order);
+		runs = 0;
+		for (i = 0; i < cnt; i++) {
+			if (i == 0 || pages[i]->page_cache.owner
+					!= pages[i - 1]->page_cache.owner
+					|| pages[i]->page_cache.ofs
+					!= pages[i - 1]->page_cache.ofs + PGSIZE)
+				runs++;
+			cache_page_write (pages[i]);
+		}
+
+		lock_acquire (&frame_lock);
+		for (i = 0; i < cnt; i++) {
+			pages[i]->frame->pin_cnt--;
+			cached_inode_put (pages[i]->page_cache.owner);
+		}
+		page_cache_stats.written += cnt;
+		page_cache_stats.runs += runs;
+		lock_release (&frame_lock);
+		total += cnt;
+	} while (cnt == want && total < max);
+	return total;
+}
+
+/* Returns how many pages of the cache may be dirty before writers are
+ * throttled. */
+static size_t
+dirty_limit (void) {
+	size_t limit = palloc_user_pages () * DIRTY_RATIO / 100;
+
+	return limit > WRITEBACK_BATCH ? limit : WRITEBACK_BATCH;
+}
+
+/* Holds a writer to INODE back while too much of the cache is dirty: it
+ * writes back pages of INODE until the excess is gone, or INODE has no
+ * dirty pages left.  The daemon alone would fall behind a fast writer and
+ * leave the cache full of pages that cannot be evicted without I/O. */
+static void
+balance_dirty (struct inode *inode) {
+	size_t limit = dirty_limit ();
+
+	if (dirty_cnt <= limit)
+		return;
+	page_cache_stats.throttled++;
+	writeback (inode, 0, OFS_MAX, INT64_MAX, dirty_cnt - limit);
+}
+
+/* Writes back the dirty pages of INODE at offsets from START up to END,
+ * and has them on the disk before returning. */
+void
+page_cache_sync (struct inode *inode, off_t start, off_t end) {
+	if (enabled) {
+		writeback (inode, start, end, INT64_MAX, cached_cnt);
+		buffer_cache_flush ();
+	}
+}
+
+/* Writes every dirty page in the cache back to its file. */
+void
+page_cache_flush (void) {
+	if (enabled)
+		writeback (NULL, 0, OFS_MAX, INT64_MAX, cached_cnt);
+}
+
+/* Stores the number of dirty pages in the cache and of pages written back
+ * so far into STATS, for SYS_CACHE_STATS. */
+void
+page_cache_stats_read (struct cache_stats *stats) {
+	lock_acquire (&frame_lock);
+	stats->dirty = dirty_cnt;
+	stats->written = page_cache_stats.written;
+	lock_release (&frame_lock);
+}
+
+/* Prints page cache statistics. */
+void
+page_cache_print_stats (void) {
+	printf ("Page cache: %llu hits, %llu misses, %llu pages written back "
+			"in %llu runs, %llu writers throttled\n",
+			page_cache_stats.hits, page_cache_stats.misses,
+			page_cache_stats.written, page_cache_stats.runs,
+			page_cache_stats.throttled);
 }
 
 /* Utilze the Swap in mechanism to implement readhead */
 static bool
 page_cache_readahead (struct page *page, void *kva) {
+	struct page_cache *pc = &page->page_cache;
+	off_t bytes_read = inode_read_disk (pc->owner->inode, kva, PGSIZE, pc->ofs);
+
+	if (bytes_read < 0)
+		bytes_read = 0;
+	memset ((uint8_t *) kva + bytes_read, 0, PGSIZE - bytes_read);
+	return true;
 }
 
-/* Utilze the Swap out mechanism to implement writeback */
+/* Utilze the Swap out mechanism to implement writeback.  The eviction
+ * path calls this without frame_lock, on a page nobody else can reach;
+ * the caller marks the page clean afterward. */
 static bool
 page_cache_writeback (struct page *page) {
+	if (page->page_cache.dirty)
+		cache_page_write (page);
+	return true;
 }
 
 /* Destory the page_cache. */
 static void
 page_cache_destroy (struct page *page) {
+	if (page->frame != NULL) {
+		page_cache_writeback (page);
+		cache_page_written (page);
+	}
 }
 
-/* Worker thread for page cache */
+/* Worker thread for page cache.  Writes back the pages that have been
+ * dirty for DIRTY_EXPIRE ticks, so that data reaches the disk in bounded
+ * time without a process having to wait for it, and so that neither
+ * eviction nor the exit of a process with a large dirty mapping meets a
+ * backlog of dirty pages. */
 static void
-page_cache_kworkerd (void *aux) {
+page_cache_kworkerd (void *aux UNUSED) {
+	for (;;) {
+		timer_sleep (WRITEBACK_INTERVAL);
+		writeback (NULL, 0, OFS_MAX, timer_ticks () - DIRTY_EXPIRE, SIZE_MAX);
+	}
+}
+
+/* Returns a hash value for the cached inode that E belongs to. */
+static uint64_t
+cached_inode_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct cached_inode *ci = hash_entry (e, struct cached_inode, elem);
+	return hash_bytes (&ci->inode, sizeof ci->inode);
+}
+
+/* Orders cached inodes by address. */
+static bool
+cached_inode_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return hash_entry (a, struct cached_inode, elem)->inode
+		< hash_entry (b, struct cached_inode, elem)->inode;
+}
+
+/* Returns a hash value for the cache page that E belongs to. */
+static uint64_t
+cache_page_hash (const struct hash_elem *e, void *aux UNUSED) {
+	return hash_int (hash_entry (e, struct page, page_cache.elem)
+			->page_cache.ofs);
+}
+
+/* Orders the cache pages of an inode by offset. */
+static bool
+cache_page_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return hash_entry (a, struct page, page_cache.elem)->page_cache.ofs
+		< hash_entry (b, struct page, page_cache.elem)->page_cache.ofs;
 }
+#endif /* VM */
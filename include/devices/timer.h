@@ -10,6 +10,7 @@
 void timer_init (void);
 void timer_calibrate (void);
 
+int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
 int64_t wakeup_time(void);
 void timer_sleep (int64_t ticks);
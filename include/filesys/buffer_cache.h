@@ -0,0 +1,29 @@
+#ifndef FILESYS_BUFFER_CACHE_H
+#define FILESYS_BUFFER_CACHE_H
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/disk.h"
+
+/* Number of sectors the buffer cache holds, 0 to disable it.
+ * Set by the "-bc=N" kernel option. */
+extern size_t buffer_cache_size;
+
+/* Buffer cache statistics. */
+struct buffer_cache_stats {
+	unsigned long long hits;    /* Accesses to a cached sector. */
+	unsigned long long misses;  /* Accesses that had to fill an entry. */
+	unsigned long long written; /* Dirty sectors written back. */
+	unsigned long long prefetched; /* Sectors read ahead. */
+};
+extern struct buffer_cache_stats buffer_cache_stats;
+
+void buffer_cache_init (void);
+void buffer_cache_read (disk_sector_t sector, void *buffer, int ofs,
+		int size);
+void buffer_cache_write (disk_sector_t sector, const void *buffer, int ofs,
+		int size);
+void buffer_cache_readahead (disk_sector_t sector);
+void buffer_cache_flush (void);
+void buffer_cache_print_stats (void);
+
+#endif /* filesys/buffer_cache.h */
@@ -0,0 +1,26 @@
+#ifndef FILESYS_DENTRY_H
+#define FILESYS_DENTRY_H
+#include <stdbool.h>
+#include "devices/disk.h"
+
+/* Child sector of a negative entry: the name is known not to exist. */
+#define DENTRY_NONE ((disk_sector_t) -1)
+
+/* Dentry cache statistics. */
+struct dentry_stats {
+	unsigned long long hits;    /* Lookups answered with a file. */
+	unsigned long long negative; /* Lookups answered with no file. */
+	unsigned long long misses;  /* Lookups that had to search. */
+	unsigned long long evicted; /* Entries dropped to make room. */
+};
+extern struct dentry_stats dentry_stats;
+
+void dentry_init (void);
+bool dentry_lookup (disk_sector_t parent, const char *name,
+		disk_sector_t *child);
+void dentry_insert (disk_sector_t parent, const char *name,
+		disk_sector_t child);
+void dentry_invalidate (disk_sector_t parent, const char *name);
+void dentry_print_stats (void);
+
+#endif /* filesys/dentry.h */
@@ -3,6 +3,7 @@
 
 #include "devices/disk.h"
 #include "filesys/file.h"
+#include "threads/synch.h"
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stddef.h>
@@ -14,10 +15,14 @@ typedef uint32_t cluster_t;  /* Index of a cluster within FAT. */
 #define EOChain 0x0FFFFFFF   /* End of cluster chain */
 
 /* Sectors of FAT information. */
-#define SECTORS_PER_CLUSTER 1 /* Number of sectors per cluster */
+#define FAT_CLUSTER_MAX 64    /* Most sectors a cluster may have. */
 #define FAT_BOOT_SECTOR 0     /* FAT boot sector. */
 #define ROOT_DIR_CLUSTER 1    /* Cluster for the root directory */
 
+/* Sectors per cluster of file systems formatted from now on.
+ * Set by the "-cs=N" kernel option. */
+extern unsigned int fat_format_cluster_sectors;
+
 void fat_init (void);
 void fat_open (void);
 void fat_close (void);
@@ -34,5 +39,23 @@ void fat_remove_chain (
 cluster_t fat_get (cluster_t clst);
 void fat_put (cluster_t clst, cluster_t val);
 disk_sector_t cluster_to_sector (cluster_t clst);
+cluster_t sector_to_cluster (disk_sector_t sector);
+unsigned int fat_cluster_sectors (void);
+
+/* Cached positions in a cluster chain, so that finding the Nth cluster
+ * of a long chain does not take a walk from its head every time.  Looked
+ * up by every reader of a file at once, so it has a lock of its own. */
+struct fat_chain {
+	struct lock lock;           /* Protects the members below. */
+	cluster_t *marks;           /* Every FAT_CHAIN_STRIDE-th cluster. */
+	size_t mark_cnt;            /* Entries of MARKS in use. */
+	size_t mark_cap;            /* Entries MARKS has room for. */
+	size_t last_idx;            /* Position looked up last... */
+	cluster_t last;             /* ...and its cluster, 0 if none. */
+};
+
+void fat_chain_init (struct fat_chain *);
+void fat_chain_destroy (struct fat_chain *);
+cluster_t fat_chain_get (struct fat_chain *, cluster_t start, size_t idx);
 
 #endif /* filesys/fat.h */
@@ -1,12 +1,58 @@
 #ifndef FILESYS_PAGE_CACHE_H
 #define FILESYS_PAGE_CACHE_H
-#include "vm/vm.h"
+#include <hash.h>
+#include "filesys/off_t.h"
 
 struct page;
+struct frame;
+struct inode;
+struct supplemental_page_table;
+struct cached_inode;
+struct cache_stats;
 enum vm_type;
 
-struct page_cache {};
+/* A page of the page cache: the contents of a file from OFS to OFS +
+ * PGSIZE, held in a frame that every process mapping that part of the file
+ * maps, and that reads and writes through the file system copy to and
+ * from.  Protected by frame_lock. */
+struct page_cache {
+	struct cached_inode *owner; /* The cached pages of the file. */
+	off_t ofs;                  /* Offset of the page in the file. */
+	struct hash_elem elem;      /* Element in the owner's pages. */
+	bool dirty;                 /* Written since it was last written back? */
+	int64_t dirtied;            /* Timer tick it became dirty. */
+	bool accessed;              /* Read or written since the clock passed? */
+	int copiers;                /* Reads copying out, or -1 for a write. */
+};
 
-void page_cache_init (void);
+/* Page cache statistics, counted under frame_lock. */
+struct page_cache_stats {
+	unsigned long long hits;    /* Lookups that found the page resident. */
+	unsigned long long misses;  /* Lookups that had to read the page. */
+	unsigned long long written; /* Pages written back to their file. */
+	unsigned long long runs;    /* Runs of contiguous pages written. */
+	unsigned long long throttled; /* Writes held back to write pages. */
+};
+extern struct page_cache_stats page_cache_stats;
+
+void pagecache_init (void);
 bool page_cache_initializer (struct page *page, enum vm_type type, void *kva);
+bool page_cache_enabled (void);
+off_t page_cache_read (struct inode *inode, void *buffer, off_t size,
+		off_t offset);
+off_t page_cache_write (struct inode *inode, const void *buffer, off_t size,
+		off_t offset);
+struct frame *page_cache_get (struct inode *inode, off_t ofs,
+		struct supplemental_page_table *spt, bool evict);
+void page_cache_put (struct frame *frame, bool dirty);
+void page_cache_mark_dirty (struct page *page);
+void page_cache_evict (struct frame *frame);
+void page_cache_evict_end (struct frame *frame);
+void page_cache_drop (struct inode *inode, bool write_back);
+void page_cache_sync (struct inode *inode, off_t start, off_t end);
+void page_cache_grow (struct inode *inode, off_t old_length,
+		off_t new_length);
+void page_cache_flush (void);
+void page_cache_stats_read (struct cache_stats *stats);
+void page_cache_print_stats (void);
 #endif
@@ -22,6 +22,11 @@ enum {
 	/* Project 3 and optionally project 4. */
 	SYS_MMAP,                   /* Map a file into memory. */
 	SYS_MUNMAP,                 /* Remove a memory mapping. */
+	SYS_MADVISE,                /* Advise on the use of a memory range. */
+	SYS_SBRK,                   /* Grow or shrink the heap. */
+	SYS_MSYNC,                  /* Write back a memory mapping. */
+	SYS_FAULT_STATS,            /* Read page fault statistics (debugging). */
+	SYS_CACHE_STATS,            /* Read page cache statistics (debugging). */
 
 	/* Project 4 only. */
 	SYS_CHDIR,                  /* Change the current directory. */
@@ -38,4 +43,52 @@ enum {
 	SYS_UMOUNT,
 };
 
+/* File descriptor passed to SYS_MMAP for zero-filled memory backed by no
+ * file. */
+#define MAP_ANONYMOUS (-1)
+
+/* Advice values for SYS_MADVISE. */
+#define MADV_NORMAL     0       /* No particular access pattern. */
+#define MADV_RANDOM     1       /* Random access: no fault-around. */
+#define MADV_SEQUENTIAL 2       /* Sequential access: read ahead, drop behind. */
+#define MADV_WILLNEED   3       /* Will be accessed soon: prefetch. */
+#define MADV_DONTNEED   4       /* Not needed anymore: free the frames. */
+
+/* Flags for SYS_MSYNC. */
+#define MS_ASYNC        1       /* Leave the writes to the writeback daemon. */
+#define MS_SYNC         4       /* Write back before returning. */
+
+/* Classes of page faults counted by SYS_FAULT_STATS. */
+enum {
+	FAULT_LAZY_LOAD,            /* First load of a page set up lazily. */
+	FAULT_ZERO_FILL,            /* First touch of anonymous memory. */
+	FAULT_STACK_GROWTH,         /* Access below the stack, which grew. */
+	FAULT_COW,                  /* Write to a shared or zero page. */
+	FAULT_SWAP_IN,              /* Anonymous page read back from swap. */
+	FAULT_FILE_IN,              /* File page read back after eviction. */
+	FAULT_INVALID,              /* Invalid access. */
+	FAULT_CLASS_CNT
+};
+
+/* Scopes for SYS_FAULT_STATS. */
+#define FAULT_STATS_PROCESS 0   /* Faults of the calling process. */
+#define FAULT_STATS_GLOBAL  1   /* Faults of every thread since boot. */
+
+/* Latency histogram buckets: bucket I counts faults handled in 2**I up to
+ * 2**(I + 1) TSC cycles; the last one also counts the longer ones. */
+#define FAULT_HIST_BUCKETS 32
+
+/* Page fault statistics, as returned by SYS_FAULT_STATS.  Latencies are
+ * only kept globally; for a process, HIST is all zeros. */
+struct fault_stats {
+	unsigned long long cnt[FAULT_CLASS_CNT];
+	unsigned long long hist[FAULT_CLASS_CNT][FAULT_HIST_BUCKETS];
+};
+
+/* Page cache statistics, as returned by SYS_CACHE_STATS. */
+struct cache_stats {
+	unsigned long long dirty;   /* Pages now known to be dirty. */
+	unsigned long long written; /* Pages written back since boot. */
+};
+
 #endif /* lib/syscall-nr.h */
@@ -4,6 +4,8 @@
 #include <stdbool.h>
 #include <debug.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <syscall-nr.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -41,6 +43,11 @@ int dup2(int oldfd, int newfd);
 /* Project 3 and optionally project 4. */
 void *mmap (void *addr, size_t length, int writable, int fd, off_t offset);
 void munmap (void *addr);
+int madvise (void *addr, size_t length, int advice);
+void *sbrk (intptr_t increment);
+int msync (void *addr, size_t length, int flags);
+int fault_stats (int scope, struct fault_stats *stats);
+int cache_stats (struct cache_stats *stats);
 
 /* Project 4 only. */
 bool chdir (const char *dir);
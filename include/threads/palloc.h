@@ -19,5 +19,7 @@ void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+size_t palloc_user_pages (void);
+size_t palloc_user_free_pages (void);
 
 #endif /* threads/palloc.h */
@@ -24,6 +24,9 @@ enum thread_status {
 typedef int tid_t;
 #define TID_ERROR ((tid_t) -1)          /* Error value for tid_t. */
 
+/* Size of a process's file descriptor table. */
+#define FD_MAX 128
+
 /* Thread priorities. */
 #define PRI_MIN 0                       /* Lowest priority. */
 #define PRI_DEFAULT 31                  /* Default priority. */
@@ -109,10 +112,18 @@ struct thread {
 	struct list_elem child_elem;        /* 부모의 child_list에 연결될 요소 */
 	/* For process synchronization */
 	struct semaphore wait_sema;         /* 자식의 종료를 기다리기 위한 세마포어 */
+	struct semaphore free_sema;         /* Upped once the parent reaped us. */
+	struct semaphore fork_sema;         /* Upped when fork() is done copying. */
+	struct intr_frame *fork_if;         /* User context being forked. */
+	bool is_process;                    /* Runs a user program. */
+	/* Open files */
+	struct file **fd_table;             /* Open files, indexed by fd. */
+	struct file *running_file;          /* Executable, kept write-denied. */
 #endif
 #ifdef VM
 	/* Table for whole virtual memory owned by thread. */
 	struct supplemental_page_table spt;
+	uintptr_t user_rsp;                 /* User rsp on entry to a syscall. */
 #endif
 
 	/* Owned by thread.c. */
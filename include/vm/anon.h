@@ -1,13 +1,27 @@
 #ifndef VM_ANON_H
 #define VM_ANON_H
+#include <stddef.h>
+#include <stdint.h>
 #include "vm/vm.h"
 struct page;
+struct zswap_entry;
 enum vm_type;
 
+/* An evicted anonymous page lives either in the compressed cache or in a
+ * swap slot, never both. */
 struct anon_page {
+	size_t swap_slot;           /* Slot holding the page, or SWAP_SLOT_NONE. */
+	struct zswap_entry *zentry; /* Compressed copy, or NULL. */
+	enum vm_type type;          /* Type allocated with, markers included. */
 };
 
+/* Marks an anonymous page that is not in swap. */
+#define SWAP_SLOT_NONE ((size_t) -1)
+
 void vm_anon_init (void);
 bool anon_initializer (struct page *page, enum vm_type type, void *kva);
+size_t anon_swap_write (const void *kva);
+void *do_mmap_anon (void *addr, size_t length, bool writable);
+void *do_sbrk (intptr_t increment);
 
 #endif
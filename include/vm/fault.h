@@ -0,0 +1,17 @@
+#ifndef VM_FAULT_H
+#define VM_FAULT_H
+#include <stdbool.h>
+#include <stdint.h>
+#include <syscall-nr.h>
+
+struct supplemental_page_table;
+
+/* Faults of every thread since boot, by class, with their latencies. */
+extern struct fault_stats vm_fault_stats;
+
+void fault_record (struct supplemental_page_table *spt, int cls,
+		uint64_t cycles);
+bool fault_stats_read (int scope, struct fault_stats *stats);
+void fault_print_stats (void);
+
+#endif /* vm/fault.h */
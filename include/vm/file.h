@@ -6,12 +6,35 @@
 struct page;
 enum vm_type;
 
+/* Where a lazily loaded page gets its contents from.  Passed as the aux of
+ * file_lazy_load () by both executable segments and memory mappings. */
+struct file_load_info {
+	struct file *file;          /* File to read from. */
+	off_t ofs;                  /* Offset of the page within FILE. */
+	size_t read_bytes;          /* Bytes read from FILE; the rest is zeroed. */
+	void *map_addr;             /* Start of the mapping, NULL if not mmap'd. */
+};
+
+/* A page backed by a file.  Mapped pages borrow FILE from their area, which
+ * outlives them; read-only executable text borrows the process's
+ * running_file and has a NULL MAP_ADDR. */
 struct file_page {
+	struct file *file;          /* Backing file, see below. */
+	off_t ofs;                  /* Offset of the page within FILE. */
+	size_t read_bytes;          /* Bytes backed by FILE; the rest is zero. */
+	void *map_addr;             /* Start of the mapping this page is part of. */
 };
 
 void vm_file_init (void);
 bool file_backed_initializer (struct page *page, enum vm_type type, void *kva);
+bool file_lazy_load (struct page *page, void *aux);
+bool file_page_source (struct page *page, struct inode **inode, off_t *ofs);
+bool file_cache_source (struct page *page, struct inode **inode, off_t *ofs);
+void file_cache_attach (struct page *page);
+void file_page_drop (struct page *page);
+struct file_load_info *file_load_info_copy (struct page *page);
 void *do_mmap(void *addr, size_t length, int writable,
 		struct file *file, off_t offset);
 void do_munmap (void *va);
+bool do_msync (void *addr, size_t length, int flags);
 #endif
@@ -0,0 +1,23 @@
+#ifndef VM_KSM_H
+#define VM_KSM_H
+#include <stdbool.h>
+#include <stdint.h>
+
+struct frame;
+
+/* Same-page merging statistics. */
+struct ksm_stats {
+	uint64_t scanned;           /* Frames hashed by the scanner. */
+	uint64_t merged;            /* Pages remapped onto an identical frame. */
+	uint64_t broken;            /* Merged pages copied again on write. */
+};
+
+/* Run the page merger?  Set by the "-ksm" kernel option. */
+extern bool ksm_enabled;
+extern struct ksm_stats ksm_stats;
+
+void ksm_init (void);
+void ksm_forget_frame (struct frame *frame);
+void ksm_print_stats (void);
+
+#endif /* vm/ksm.h */
@@ -0,0 +1,23 @@
+#ifndef VM_KSWAPD_H
+#define VM_KSWAPD_H
+#include <stddef.h>
+#include <stdint.h>
+
+/* Page reclaim statistics. */
+struct reclaim_stats {
+	uint64_t direct;            /* Pages evicted by faulting threads. */
+	uint64_t background;        /* Pages evicted by the page-out daemon. */
+	uint64_t wakeups;           /* Times the daemon was woken. */
+};
+
+/* Free user frames below which the page-out daemon is woken, 0 to run
+ * without it.  Set by the "-kswapd=PAGES" kernel option; defaults to a
+ * share of the user pool. */
+extern size_t kswapd_low;
+extern struct reclaim_stats reclaim_stats;
+
+void kswapd_init (void);
+void kswapd_check (void);
+void kswapd_print_stats (void);
+
+#endif /* vm/kswapd.h */
@@ -0,0 +1,20 @@
+#ifndef VM_REAPER_H
+#define VM_REAPER_H
+#include <stdbool.h>
+#include <stdint.h>
+
+struct thread;
+
+/* Address space teardown statistics. */
+struct reaper_stats {
+	uint64_t background;        /* Address spaces freed by the reaper. */
+	uint64_t on_demand;         /* Frames freed by threads short of them. */
+};
+extern struct reaper_stats reaper_stats;
+
+void reaper_init (void);
+bool reaper_defer (struct thread *t);
+bool reaper_reclaim (void);
+void reaper_print_stats (void);
+
+#endif /* vm/reaper.h */
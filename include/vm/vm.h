@@ -1,6 +1,9 @@
 #ifndef VM_VM_H
 #define VM_VM_H
 #include <stdbool.h>
+#include <hash.h>
+#include <list.h>
+#include <syscall-nr.h>
 #include "threads/palloc.h"
 
 enum vm_type {
@@ -20,6 +23,9 @@ enum vm_type {
 	VM_MARKER_0 = (1 << 3),
 	VM_MARKER_1 = (1 << 4),
 
+	/* Marks the pages of the user stack. */
+	VM_STACK = VM_MARKER_0,
+
 	/* DO NOT EXCEED THIS VALUE. */
 	VM_MARKER_END = (1 << 31),
 };
@@ -27,9 +33,8 @@ enum vm_type {
 #include "vm/uninit.h"
 #include "vm/anon.h"
 #include "vm/file.h"
-#ifdef EFILESYS
+#include "vm/vma.h"
 #include "filesys/page_cache.h"
-#endif
 
 struct page_operations;
 struct thread;
@@ -46,6 +51,21 @@ struct page {
 	struct frame *frame;   /* Back reference for frame */
 
 	/* Your implementation */
+	struct hash_elem spt_elem;  /* Element in the supplemental page table. */
+	struct list_elem frame_elem; /* Element in its frame's page list. */
+	struct supplemental_page_table *spt; /* Table this page belongs to. */
+	uint64_t *pml4;             /* Page table that maps this page. */
+	bool writable;              /* May the user write to this page? */
+	int advice;                 /* MADV_* access pattern hint. */
+	struct vma *vma;            /* Area the page is in, or NULL. */
+	struct list_elem vma_elem;  /* Element in the area's pages. */
+
+	/* Accessed bits taken from the page table, kept for whichever of the
+	 * clock and the working set estimate did not take them.  Protected by
+	 * frame_lock. */
+	bool clock_ref;             /* Accessed since the clock last passed? */
+	bool wss_ref;               /* Accessed since the last estimate? */
+	bool in_wss;                /* Accessed in the last estimate's window? */
 
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
@@ -53,16 +73,31 @@ struct page {
 		struct uninit_page uninit;
 		struct anon_page anon;
 		struct file_page file;
-#ifdef EFILESYS
 		struct page_cache page_cache;
-#endif
 	};
 };
 
-/* The representation of "frame" */
+/* The representation of "frame".
+ * A frame of the page cache is mapped by every process mapping that part of
+ * the file, and identical anonymous pages may be merged into one
+ * write-protected frame (see ksm.c); PAGE is then any one of the pages
+ * mapping it. */
 struct frame {
 	void *kva;
 	struct page *page;
+	struct list_elem elem;      /* Element in the frame table. */
+	struct list pages;          /* Pages mapping this frame. */
+
+	/* Page cache frames only. */
+	struct page *cache;         /* Cache page held in the frame, or NULL. */
+	int pin_cnt;                /* Not evicted while positive. */
+
+	bool evicting;              /* Being written out by the evictor? */
+
+	/* Owned by vm/ksm.c. */
+	struct hash_elem ksm_elem;  /* Element in the stable frame table. */
+	uint64_t checksum;          /* Contents hash at the last scan. */
+	bool ksm_listed;            /* In the stable frame table? */
 };
 
 /* The function table for page operations.
@@ -85,8 +120,52 @@ struct page_operations {
  * We don't want to force you to obey any specific design for this struct.
  * All designs up to you for this. */
 struct supplemental_page_table {
+	struct hash pages;          /* Pages, keyed by user virtual address. */
+	void *fa_next;              /* Page a sequential reader faults next. */
+	size_t fa_window;           /* Current fault-around window in pages. */
+
+	/* Resident memory, in pages, counted under frame_lock. */
+	size_t rss;                 /* Pages mapped to a frame. */
+	size_t rss_limit;           /* Limit on RSS, 0 if none. */
+	size_t wss;                 /* Estimated working set. */
+	int64_t wss_stamp;          /* Timer tick of the last estimate. */
+
+	/* Dynamically allocated memory. */
+	void *heap_start;           /* Start of the heap, after the data. */
+	void *brk;                  /* Current end of the heap. */
+
+	struct vma *vmas;           /* Root of the tree of areas. */
+	struct vma *heap;           /* Area of the heap, NULL while empty. */
+
+	/* Page faults taken, by FAULT_* class. */
+	unsigned long long faults[FAULT_CLASS_CNT];
 };
 
+/* Largest distance below USER_STACK the stack may grow to.  Anonymous
+ * mappings at addresses of the kernel's choosing are placed below it. */
+#define STACK_LIMIT (1 << 20)
+
+/* Maximum number of pages mapped around a file-backed fault.
+ * Set by the "-fa=N" kernel option; 0 disables fault-around. */
+extern size_t vm_fault_around_max;
+
+/* Resident page limit of new processes, 0 for none.  Set by the
+ * "-rss=PAGES" kernel option. */
+extern size_t vm_rss_limit;
+
+/* Every frame that holds a user page, and the lock protecting it along
+ * with each frame's list of pages.  Shared with the page merger. */
+extern struct list frame_table;
+extern struct lock frame_lock;
+extern struct condition frame_evicted;
+struct frame *vm_alloc_frame (struct supplemental_page_table *spt,
+		bool evict);
+void vm_discard_frame (struct frame *frame);
+void vm_free_frame (struct frame *frame);
+void vm_unlink_page (struct page *page);
+void vm_wait_evicted (struct page *page);
+size_t vm_reclaim (size_t cnt);
+
 #include "threads/thread.h"
 void supplemental_page_table_init (struct supplemental_page_table *spt);
 bool supplemental_page_table_copy (struct supplemental_page_table *dst,
@@ -107,6 +186,8 @@ bool vm_alloc_page_with_initializer (enum vm_type type, void *upage,
 		bool writable, vm_initializer *init, void *aux);
 void vm_dealloc_page (struct page *page);
 bool vm_claim_page (void *va);
+bool vm_advise (void *addr, size_t length, int advice);
+void vm_release_frame (struct page *page);
 enum vm_type page_get_type (struct page *page);
 
 #endif  /* VM_VM_H */
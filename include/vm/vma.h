@@ -0,0 +1,51 @@
+#ifndef VM_VMA_H
+#define VM_VMA_H
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "filesys/off_t.h"
+
+struct file;
+struct supplemental_page_table;
+
+/* Flags of a virtual memory area. */
+#define VMA_WRITABLE 0x1        /* Pages may be written by the user. */
+#define VMA_MAPPED 0x2          /* Made by mmap (), removed by munmap (). */
+#define VMA_STACK 0x4           /* Reserved for the user stack. */
+#define VMA_HEAP 0x8            /* The heap, grown and shrunk by sbrk (). */
+
+/* A virtual memory area: a range of pages of a process that were set up
+ * together, such as a segment of the executable, the stack, the heap or a
+ * memory mapping.  The areas of a process never overlap.  They are kept in
+ * an AVL tree ordered by start address, where each node also records the
+ * largest end address in its subtree, so that finding an area that
+ * overlaps a range takes O(log n). */
+struct vma {
+	void *start;                /* First page of the area. */
+	void *end;                  /* One past its last byte, page-aligned. */
+	struct file *file;          /* Backing file, or NULL if anonymous. */
+	off_t ofs;                  /* Offset of START within FILE. */
+	int flags;                  /* VMA_* flags. */
+	struct list pages;          /* Pages set up in the area. */
+
+	/* Owned by vm/vma.c. */
+	struct vma *left, *right;   /* Children in the area tree. */
+	int height;                 /* Height of the subtree rooted here. */
+	uintptr_t max_end;          /* Largest END in the subtree. */
+};
+
+struct vma *vma_create (struct supplemental_page_table *spt, void *start,
+		void *end, struct file *file, off_t ofs, int flags);
+void vma_destroy (struct supplemental_page_table *spt, struct vma *vma);
+bool vma_resize (struct supplemental_page_table *spt, struct vma *vma,
+		void *end);
+struct vma *vma_find (struct supplemental_page_table *spt, const void *addr);
+struct vma *vma_overlap (struct supplemental_page_table *spt,
+		const void *start, const void *end);
+void *vma_find_free (struct supplemental_page_table *spt, size_t length,
+		const void *floor, const void *ceiling);
+bool vma_copy (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src);
+void vma_kill (struct supplemental_page_table *spt);
+
+#endif /* vm/vma.h */
@@ -0,0 +1,18 @@
+#ifndef VM_ZSWAP_H
+#define VM_ZSWAP_H
+#include <stdbool.h>
+#include <stddef.h>
+
+struct page;
+
+/* Size of the compressed swap cache in kernel pages; 0 disables it.
+ * Set by the "-zswap=PAGES" kernel option. */
+extern size_t zswap_pages;
+
+void zswap_init (void);
+bool zswap_store (struct page *page, const void *kva);
+bool zswap_load (struct page *page, void *kva);
+void zswap_drop (struct page *page);
+void zswap_print_stats (void);
+
+#endif /* vm/zswap.h */
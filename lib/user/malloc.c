@@ -0,0 +1,294 @@
+#include <malloc.h>
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "threads/vaddr.h"
+
+/* A user-level malloc().
+
+   Like the kernel's allocator, requests are rounded up to a power
+   of 2 and served from "arenas", pages divided into blocks of
+   one size.  Arenas come from the heap, which sbrk() grows a
+   page at a time.  Each arena keeps its own list of free blocks,
+   and each size class a list of the arenas that have any.
+
+   An arena whose blocks are all free again is given back.  If it
+   is at the top of the heap, the heap shrinks; otherwise its page
+   is dropped with madvise(MADV_DONTNEED), which frees the memory
+   but keeps the address, and the arena is kept for reuse.  Either
+   way a program that frees what it allocated stops paying for it.
+
+   Blocks too big for an arena get a mapping of their own from
+   mmap(), which free() unmaps. */
+
+/* Size class. */
+struct desc {
+	size_t block_size;          /* Size of each element in bytes. */
+	size_t blocks_per_arena;    /* Number of blocks in an arena. */
+	struct arena *partial;      /* Arenas with free blocks. */
+};
+
+/* Magic number for detecting arena corruption. */
+#define ARENA_MAGIC 0x9a548eed
+
+/* Arena. */
+struct arena {
+	unsigned magic;             /* Always set to ARENA_MAGIC. */
+	struct desc *desc;          /* Owning descriptor, null for big block. */
+	size_t free_cnt;            /* Free blocks; pages in big block. */
+	struct block *free_list;    /* Free blocks of this arena. */
+	struct arena *prev, *next;  /* Neighbours in the descriptor's partial. */
+};
+
+/* Free block. */
+struct block {
+	struct block *next;         /* Next free block in the arena. */
+};
+
+/* Our set of descriptors. */
+static struct desc descs[10];   /* Descriptors. */
+static size_t desc_cnt;         /* Number of descriptors. */
+
+/* Empty arenas whose pages were dropped, ready for reuse. */
+#define SPARE_MAX 256
+static struct arena *spares[SPARE_MAX];
+static size_t spare_cnt;
+
+static struct arena *block_to_arena (struct block *);
+
+/* Initializes the descriptors on first use. */
+static void
+malloc_init (void) {
+	size_t block_size;
+
+	for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2) {
+		struct desc *d = &descs[desc_cnt++];
+		ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
+		d->block_size = block_size;
+		d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
+		d->partial = NULL;
+	}
+}
+
+/* Adds A to the arenas of its descriptor that have free blocks. */
+static void
+partial_push (struct arena *a) {
+	struct desc *d = a->desc;
+
+	a->prev = NULL;
+	a->next = d->partial;
+	if (d->partial != NULL)
+		d->partial->prev = a;
+	d->partial = a;
+}
+
+/* Removes A from the arenas of its descriptor that have free blocks. */
+static void
+partial_remove (struct arena *a) {
+	if (a->prev != NULL)
+		a->prev->next = a->next;
+	else
+		a->desc->partial = a->next;
+	if (a->next != NULL)
+		a->next->prev = a->prev;
+}
+
+/* Returns a page for a new arena, or a null pointer if the heap
+   cannot grow. */
+static struct arena *
+arena_get (void) {
+	uintptr_t brk;
+	size_t pad;
+
+	if (spare_cnt > 0)
+		return spares[--spare_cnt];
+
+	/* Someone else may have moved the break by less than a page. */
+	brk = (uintptr_t) sbrk (0);
+	pad = ROUND_UP (brk, PGSIZE) - brk;
+	if (sbrk (pad + PGSIZE) == (void *) -1)
+		return NULL;
+	return (struct arena *) (brk + pad);
+}
+
+/* Gives back the page of A, an arena with no blocks in use.
+   Returns false if A has to be kept as it is. */
+static bool
+arena_put (struct arena *a) {
+	if ((uintptr_t) a + PGSIZE == (uintptr_t) sbrk (0))
+		return sbrk (-PGSIZE) != (void *) -1;
+	if (spare_cnt == SPARE_MAX || madvise (a, PGSIZE, MADV_DONTNEED) != 0)
+		return false;
+	spares[spare_cnt++] = a;
+	return true;
+}
+
+/* Obtains and returns a new block of at least SIZE bytes.
+   Returns a null pointer if memory is not available. */
+void *
+malloc (size_t size) {
+	struct desc *d;
+	struct block *b;
+	struct arena *a;
+
+	/* A null pointer satisfies a request for 0 bytes. */
+	if (size == 0)
+		return NULL;
+	if (desc_cnt == 0)
+		malloc_init ();
+
+	/* Find the smallest descriptor that satisfies a SIZE-byte
+	   request. */
+	for (d = descs; d < descs + desc_cnt; d++)
+		if (d->block_size >= size)
+			break;
+	if (d == descs + desc_cnt) {
+		/* SIZE is too big for any descriptor.
+		   Map enough pages to hold SIZE plus an arena. */
+		size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
+		if (page_cnt < size / PGSIZE)
+			return NULL;
+		a = mmap (NULL, page_cnt * PGSIZE, true, MAP_ANONYMOUS, 0);
+		if (a == MAP_FAILED)
+			return NULL;
+
+		/* Initialize the arena to indicate a big block of PAGE_CNT
+		   pages, and return it. */
+		a->magic = ARENA_MAGIC;
+		a->desc = NULL;
+		a->free_cnt = page_cnt;
+		return a + 1;
+	}
+
+	/* If no arena has a free block, create a new one. */
+	if (d->partial == NULL) {
+		size_t i;
+
+		a = arena_get ();
+		if (a == NULL)
+			return NULL;
+
+		/* Initialize arena and put its blocks on its free list. */
+		a->magic = ARENA_MAGIC;
+		a->desc = d;
+		a->free_cnt = d->blocks_per_arena;
+		a->free_list = NULL;
+		for (i = d->blocks_per_arena; i-- > 0; ) {
+			b = (struct block *) ((uint8_t *) a + sizeof *a + i * d->block_size);
+			b->next = a->free_list;
+			a->free_list = b;
+		}
+		partial_push (a);
+	}
+
+	/* Get a block from the first arena that has one. */
+	a = d->partial;
+	b = a->free_list;
+	a->free_list = b->next;
+	if (--a->free_cnt == 0)
+		partial_remove (a);
+	return b;
+}
+
+/* Allocates and return A times B bytes initialized to zeroes.
+   Returns a null pointer if memory is not available. */
+void *
+calloc (size_t a, size_t b) {
+	void *p;
+	size_t size;
+
+	/* Calculate block size and make sure it fits in size_t. */
+	size = a * b;
+	if (b != 0 && size / b != a)
+		return NULL;
+
+	/* Allocate and zero memory. */
+	p = malloc (size);
+	if (p != NULL)
+		memset (p, 0, size);
+
+	return p;
+}
+
+/* Returns the number of bytes allocated for BLOCK. */
+static size_t
+block_size (void *block) {
+	struct arena *a = block_to_arena (block);
+	struct desc *d = a->desc;
+
+	return d != NULL ? d->block_size : PGSIZE * a->free_cnt - sizeof *a;
+}
+
+/* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
+   moving it in the process.
+   If successful, returns the new block; on failure, returns a
+   null pointer.
+   A call with null OLD_BLOCK is equivalent to malloc(NEW_SIZE).
+   A call with zero NEW_SIZE is equivalent to free(OLD_BLOCK). */
+void *
+realloc (void *old_block, size_t new_size) {
+	if (new_size == 0) {
+		free (old_block);
+		return NULL;
+	} else if (old_block != NULL && new_size <= block_size (old_block))
+		return old_block;
+	else {
+		void *new_block = malloc (new_size);
+		if (old_block != NULL && new_block != NULL) {
+			memcpy (new_block, old_block, block_size (old_block));
+			free (old_block);
+		}
+		return new_block;
+	}
+}
+
+/* Frees block P, which must have been previously allocated with
+   malloc(), calloc(), or realloc(). */
+void
+free (void *p) {
+	struct block *b = p;
+	struct arena *a;
+	struct desc *d;
+
+	if (p == NULL)
+		return;
+	a = block_to_arena (b);
+	d = a->desc;
+	if (d == NULL) {
+		/* It's a big block.  Unmap it. */
+		munmap (a);
+		return;
+	}
+
+	/* Put the block back on its arena's free list. */
+	b->next = a->free_list;
+	a->free_list = b;
+	if (a->free_cnt++ == 0)
+		partial_push (a);
+
+	/* If the arena is now entirely unused, give it back. */
+	if (a->free_cnt == d->blocks_per_arena) {
+		partial_remove (a);
+		if (!arena_put (a))
+			partial_push (a);
+	}
+}
+
+/* Returns the arena that block B is inside. */
+static struct arena *
+block_to_arena (struct block *b) {
+	struct arena *a = pg_round_down (b);
+
+	/* Check that the arena is valid. */
+	ASSERT (a != NULL);
+	ASSERT (a->magic == ARENA_MAGIC);
+
+	/* Check that the block is properly aligned for the arena. */
+	ASSERT (a->desc == NULL
+			|| (pg_ofs (b) - sizeof *a) % a->desc->block_size == 0);
+	ASSERT (a->desc != NULL || pg_ofs (b) == sizeof *a);
+
+	return a;
+}
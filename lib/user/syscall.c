@@ -155,6 +155,31 @@ munmap (void *addr) {
 	syscall1 (SYS_MUNMAP, addr);
 }
 
+int
+madvise (void *addr, size_t length, int advice) {
+	return syscall3 (SYS_MADVISE, addr, length, advice);
+}
+
+void *
+sbrk (intptr_t increment) {
+	return (void *) syscall1 (SYS_SBRK, increment);
+}
+
+int
+msync (void *addr, size_t length, int flags) {
+	return syscall3 (SYS_MSYNC, addr, length, flags);
+}
+
+int
+fault_stats (int scope, struct fault_stats *stats) {
+	return syscall2 (SYS_FAULT_STATS, scope, stats);
+}
+
+int
+cache_stats (struct cache_stats *stats) {
+	return syscall1 (SYS_CACHE_STATS, stats);
+}
+
 bool
 chdir (const char *dir) {
 	return syscall1 (SYS_CHDIR, dir);
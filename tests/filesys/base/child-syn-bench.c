@@ -0,0 +1,46 @@
+/* Child process for syn-bench test.
+   Rewrites its own chunk of the test file one block at a time,
+   then reads the whole file, several times over.  The other
+   children do the same to their chunks at the same time, so reads
+   and non-overlapping writes contend for the same inode. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/filesys/base/syn-bench.h"
+
+static char block[BLOCK_SIZE];
+
+int
+main (int argc, char *argv[])
+{
+  int child_idx;
+  int round;
+  int fd;
+  size_t ofs;
+
+  test_name = "child-syn-bench";
+  quiet = true;
+
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      memset (block, CHUNK_BYTE (child_idx, round), sizeof block);
+      seek (fd, CHUNK_SIZE * child_idx);
+      for (ofs = 0; ofs < CHUNK_SIZE; ofs += sizeof block)
+        CHECK (write (fd, block, sizeof block) == sizeof block,
+               "write \"%s\"", file_name);
+
+      seek (fd, 0);
+      for (ofs = 0; ofs < FILE_SIZE; ofs += sizeof block)
+        CHECK (read (fd, block, sizeof block) == sizeof block,
+               "read \"%s\"", file_name);
+    }
+  close (fd);
+
+  return child_idx;
+}
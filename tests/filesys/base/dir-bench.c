@@ -0,0 +1,107 @@
+/* Times creating and looking up 10,000 files in one directory, far
+   past the point where the directory gets a hash index, so that
+   the index is rebuilt several times as it grows.  Then removes
+   half of the files and creates them again, reusing the freed
+   slots, and checks that every name still resolves. */
+
+#include <random.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/filesys/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 10000
+
+static int order[FILE_CNT];
+
+/* Prints how long the phase started at START took. */
+static void
+report (const char *phase, uint64_t start)
+{
+  msg ("%s took %llu cycles", phase, bench_cycles () - start);
+}
+
+/* Stores the name of file I, or of a missing file if MISSING, into
+   NAME. */
+static void
+file_name (char name[16], int i, bool missing)
+{
+  snprintf (name, 16, "%s%d", missing ? "none" : "file", i);
+}
+
+/* Opens every file in random order, failing if any is missing. */
+static void
+open_all (void)
+{
+  char name[16];
+  int i, fd;
+
+  shuffle (order, FILE_CNT, sizeof *order);
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      file_name (name, order[i], false);
+      if ((fd = open (name)) < 2)
+        fail ("open \"%s\" failed", name);
+      close (fd);
+    }
+}
+
+void
+test_main (void)
+{
+  char name[16];
+  uint64_t start;
+  int i;
+
+  for (i = 0; i < FILE_CNT; i++)
+    order[i] = i;
+
+  msg ("create %d files", FILE_CNT);
+  start = bench_cycles ();
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      file_name (name, i, false);
+      if (!create (name, 0))
+        fail ("create \"%s\" failed", name);
+    }
+  report ("create", start);
+
+  msg ("open %d files in random order", FILE_CNT);
+  start = bench_cycles ();
+  open_all ();
+  report ("lookup", start);
+
+  msg ("open %d missing files", FILE_CNT);
+  start = bench_cycles ();
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      file_name (name, i, true);
+      if (open (name) != -1)
+        fail ("open \"%s\" succeeded", name);
+    }
+  report ("failed lookup", start);
+
+  msg ("remove %d files", FILE_CNT / 2);
+  start = bench_cycles ();
+  for (i = 0; i < FILE_CNT; i += 2)
+    {
+      file_name (name, i, false);
+      if (!remove (name))
+        fail ("remove \"%s\" failed", name);
+    }
+  report ("remove", start);
+
+  msg ("create them again");
+  start = bench_cycles ();
+  for (i = 0; i < FILE_CNT; i += 2)
+    {
+      file_name (name, i, false);
+      if (!create (name, 0))
+        fail ("create \"%s\" failed", name);
+    }
+  report ("re-create", start);
+
+  msg ("open %d files in random order", FILE_CNT);
+  open_all ();
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+# Timings differ from run to run, so leave them out of the comparison.
+my (@output) = grep (!/ cycles$/, read_text_file ("$test.output"));
+common_checks ("run", @output);
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(dir-bench) begin
+(dir-bench) create 10000 files
+(dir-bench) open 10000 files in random order
+(dir-bench) open 10000 missing files
+(dir-bench) remove 5000 files
+(dir-bench) create them again
+(dir-bench) open 10000 files in random order
+(dir-bench) end
+EOF
+pass;
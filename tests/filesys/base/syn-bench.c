@@ -0,0 +1,42 @@
+/* Measures file system throughput under contention.  Spawns
+   several child processes that each rewrite their own part of a
+   shared file while reading all of it, times them as a group,
+   then checks that every part holds what its child wrote last. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/filesys/base/syn-bench.h"
+#include "tests/filesys/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[FILE_SIZE];
+
+void
+test_main (void)
+{
+  pid_t children[CHILD_CNT];
+  uint64_t start, cycles;
+  size_t i;
+  int fd;
+
+  CHECK (create (file_name, sizeof buf), "create \"%s\"", file_name);
+
+  start = bench_cycles ();
+  exec_children ("child-syn-bench", children, CHILD_CNT);
+  wait_children (children, CHILD_CNT);
+  cycles = bench_cycles () - start;
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (read (fd, buf, sizeof buf) == sizeof buf, "read \"%s\"", file_name);
+  for (i = 0; i < sizeof buf; i++)
+    if (buf[i] != (char) CHUNK_BYTE (i / CHUNK_SIZE, ROUND_CNT - 1))
+      fail ("byte %zu of \"%s\" is %d, expected %d", i, file_name,
+            buf[i], (char) CHUNK_BYTE (i / CHUNK_SIZE, ROUND_CNT - 1));
+  msg ("close \"%s\"", file_name);
+  close (fd);
+
+  msg ("%d children read %d kB and wrote %d kB in %llu cycles",
+       CHILD_CNT, CHILD_CNT * ROUND_CNT * FILE_SIZE / 1024,
+       CHILD_CNT * ROUND_CNT * CHUNK_SIZE / 1024, cycles);
+}
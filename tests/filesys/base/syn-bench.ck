@@ -0,0 +1,32 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+# Timings differ from run to run, so leave them out of the comparison.
+my (@output) = grep (!/ cycles$/, read_text_file ("$test.output"));
+common_checks ("run", @output);
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(syn-bench) begin
+(syn-bench) create "bench"
+(syn-bench) exec child 1 of 8: "child-syn-bench 0"
+(syn-bench) exec child 2 of 8: "child-syn-bench 1"
+(syn-bench) exec child 3 of 8: "child-syn-bench 2"
+(syn-bench) exec child 4 of 8: "child-syn-bench 3"
+(syn-bench) exec child 5 of 8: "child-syn-bench 4"
+(syn-bench) exec child 6 of 8: "child-syn-bench 5"
+(syn-bench) exec child 7 of 8: "child-syn-bench 6"
+(syn-bench) exec child 8 of 8: "child-syn-bench 7"
+(syn-bench) wait for child 1 of 8 returned 0 (expected 0)
+(syn-bench) wait for child 2 of 8 returned 1 (expected 1)
+(syn-bench) wait for child 3 of 8 returned 2 (expected 2)
+(syn-bench) wait for child 4 of 8 returned 3 (expected 3)
+(syn-bench) wait for child 5 of 8 returned 4 (expected 4)
+(syn-bench) wait for child 6 of 8 returned 5 (expected 5)
+(syn-bench) wait for child 7 of 8 returned 6 (expected 6)
+(syn-bench) wait for child 8 of 8 returned 7 (expected 7)
+(syn-bench) open "bench"
+(syn-bench) read "bench"
+(syn-bench) close "bench"
+(syn-bench) end
+EOF
+pass;
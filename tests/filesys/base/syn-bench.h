@@ -0,0 +1,14 @@
+#ifndef TESTS_FILESYS_BASE_SYN_BENCH_H
+#define TESTS_FILESYS_BASE_SYN_BENCH_H
+
+#define CHILD_CNT 8
+#define BLOCK_SIZE 512
+#define CHUNK_SIZE (8 * BLOCK_SIZE)
+#define FILE_SIZE (CHILD_CNT * CHUNK_SIZE)
+#define ROUND_CNT 4
+static const char file_name[] = "bench";
+
+/* Byte that child CHILD_IDX fills its chunk with in round ROUND. */
+#define CHUNK_BYTE(CHILD_IDX, ROUND) ((CHILD_IDX) * ROUND_CNT + (ROUND) + 1)
+
+#endif /* tests/filesys/base/syn-bench.h */
@@ -0,0 +1,19 @@
+#ifndef TESTS_FILESYS_BENCH_H
+#define TESTS_FILESYS_BENCH_H
+
+#include <stdint.h>
+
+/* Returns the CPU's time-stamp counter, for timing file system
+   benchmarks.  Timings differ from run to run, so benchmarks print
+   them on lines that end in "cycles", which their .ck files leave
+   out of the comparison. */
+static inline uint64_t
+bench_cycles (void)
+{
+  uint32_t lo, hi;
+
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+#endif /* tests/filesys/bench.h */
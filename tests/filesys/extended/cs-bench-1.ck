@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+# Timings differ from run to run, so leave them out of the comparison.
+my (@output) = grep (!/ cycles$/, read_text_file ("$test.output"));
+common_checks ("run", @output);
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(cs-bench-1) begin
+(cs-bench-1) create 8 files of 1000 bytes
+(cs-bench-1) create "bench"
+(cs-bench-1) open "bench"
+(cs-bench-1) write "bench" sequentially
+(cs-bench-1) read "bench" sequentially
+(cs-bench-1) write "bench" in random order
+(cs-bench-1) read "bench" in random order
+(cs-bench-1) close "bench"
+(cs-bench-1) end
+EOF
+pass;
@@ -0,0 +1,4 @@
+/* Times file I/O on a file system formatted with
+   16-sector clusters. */
+
+#include "tests/filesys/extended/cs-bench.inc"
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+# Timings differ from run to run, so leave them out of the comparison.
+my (@output) = grep (!/ cycles$/, read_text_file ("$test.output"));
+common_checks ("run", @output);
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(cs-bench-2) begin
+(cs-bench-2) create 8 files of 1000 bytes
+(cs-bench-2) create "bench"
+(cs-bench-2) open "bench"
+(cs-bench-2) write "bench" sequentially
+(cs-bench-2) read "bench" sequentially
+(cs-bench-2) write "bench" in random order
+(cs-bench-2) read "bench" in random order
+(cs-bench-2) close "bench"
+(cs-bench-2) end
+EOF
+pass;
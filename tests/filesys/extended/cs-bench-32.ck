@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+# Timings differ from run to run, so leave them out of the comparison.
+my (@output) = grep (!/ cycles$/, read_text_file ("$test.output"));
+common_checks ("run", @output);
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(cs-bench-32) begin
+(cs-bench-32) create 8 files of 1000 bytes
+(cs-bench-32) create "bench"
+(cs-bench-32) open "bench"
+(cs-bench-32) write "bench" sequentially
+(cs-bench-32) read "bench" sequentially
+(cs-bench-32) write "bench" in random order
+(cs-bench-32) read "bench" in random order
+(cs-bench-32) close "bench"
+(cs-bench-32) end
+EOF
+pass;
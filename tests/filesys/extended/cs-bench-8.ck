@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+# Timings differ from run to run, so leave them out of the comparison.
+my (@output) = grep (!/ cycles$/, read_text_file ("$test.output"));
+common_checks ("run", @output);
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(cs-bench-8) begin
+(cs-bench-8) create 8 files of 1000 bytes
+(cs-bench-8) create "bench"
+(cs-bench-8) open "bench"
+(cs-bench-8) write "bench" sequentially
+(cs-bench-8) read "bench" sequentially
+(cs-bench-8) write "bench" in random order
+(cs-bench-8) read "bench" in random order
+(cs-bench-8) close "bench"
+(cs-bench-8) end
+EOF
+pass;
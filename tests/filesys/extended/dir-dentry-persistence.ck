@@ -0,0 +1,7 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_archive ({"a" => ["\0" x 10], "b" => ["\0" x 20],
+		"c" => ["\0" x 30], "d" => ["\0" x 40]});
+pass;
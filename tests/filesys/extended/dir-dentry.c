@@ -0,0 +1,110 @@
+/* Looks names in the root directory up before and after creating and
+   removing them, so that a cache of name lookups would hold stale
+   entries, negative and positive, if creation and removal did not drop
+   them.  Then looks up more names than such a cache holds, so that
+   entries are dropped and looked up again while names come and go. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Number of names looked up in the second part: more than the 256
+   lookups the cache keeps. */
+#define NAME_CNT 300
+
+/* Checks that NAME opens and is SIZE bytes long. */
+static void
+check_open (const char *name, int size)
+{
+  int fd;
+
+  CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+  CHECK (filesize (fd) == size, "\"%s\" is %d bytes long", name, size);
+  close (fd);
+}
+
+/* Creates, removes and creates again each of a few names, opening it
+   between each step. */
+static void
+round_trips (void)
+{
+  static const char *names[] = {"a", "b", "c", "d"};
+  size_t i;
+
+  for (i = 0; i < sizeof names / sizeof *names; i++)
+    {
+      const char *name = names[i];
+
+      CHECK (open (name) == -1, "open \"%s\" (must return -1)", name);
+      CHECK (create (name, 100 * (i + 1)), "create \"%s\"", name);
+      check_open (name, 100 * (i + 1));
+      CHECK (remove (name), "remove \"%s\"", name);
+      CHECK (open (name) == -1, "open \"%s\" (must return -1)", name);
+      CHECK (create (name, 10 * (i + 1)), "create \"%s\"", name);
+      check_open (name, 10 * (i + 1));
+    }
+}
+
+/* Returns the name of the Ith file of the second part. */
+static const char *
+file_name (int i)
+{
+  static char name[16];
+
+  snprintf (name, sizeof name, "f%d", i);
+  return name;
+}
+
+/* Runs NAME_CNT names through the cache: creates them, looks each up,
+   removes every other one and looks each up again, creates those again
+   with a different size, and finally removes them all. */
+static void
+overflow (void)
+{
+  int i;
+
+  msg ("creating f0 through f%d...", NAME_CNT - 1);
+  quiet = true;
+  for (i = 0; i < NAME_CNT; i++)
+    CHECK (create (file_name (i), 0), "create \"%s\"", file_name (i));
+  for (i = 0; i < NAME_CNT; i++)
+    check_open (file_name (i), 0);
+  quiet = false;
+
+  msg ("removing even ones...");
+  quiet = true;
+  for (i = 0; i < NAME_CNT; i += 2)
+    CHECK (remove (file_name (i)), "remove \"%s\"", file_name (i));
+  for (i = 0; i < NAME_CNT; i++)
+    if (i % 2 == 0)
+      CHECK (open (file_name (i)) == -1, "open \"%s\" (must return -1)",
+             file_name (i));
+    else
+      check_open (file_name (i), 0);
+  quiet = false;
+
+  msg ("creating even ones again...");
+  quiet = true;
+  for (i = 0; i < NAME_CNT; i += 2)
+    CHECK (create (file_name (i), 1), "create \"%s\"", file_name (i));
+  for (i = 0; i < NAME_CNT; i++)
+    check_open (file_name (i), i % 2 == 0);
+  quiet = false;
+
+  msg ("removing f0 through f%d...", NAME_CNT - 1);
+  quiet = true;
+  for (i = 0; i < NAME_CNT; i++)
+    CHECK (remove (file_name (i)), "remove \"%s\"", file_name (i));
+  for (i = 0; i < NAME_CNT; i++)
+    CHECK (open (file_name (i)) == -1, "open \"%s\" (must return -1)",
+           file_name (i));
+  quiet = false;
+}
+
+void
+test_main (void)
+{
+  round_trips ();
+  overflow ();
+}
@@ -0,0 +1,49 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-dentry) begin
+(dir-dentry) open "a" (must return -1)
+(dir-dentry) create "a"
+(dir-dentry) open "a"
+(dir-dentry) "a" is 100 bytes long
+(dir-dentry) remove "a"
+(dir-dentry) open "a" (must return -1)
+(dir-dentry) create "a"
+(dir-dentry) open "a"
+(dir-dentry) "a" is 10 bytes long
+(dir-dentry) open "b" (must return -1)
+(dir-dentry) create "b"
+(dir-dentry) open "b"
+(dir-dentry) "b" is 200 bytes long
+(dir-dentry) remove "b"
+(dir-dentry) open "b" (must return -1)
+(dir-dentry) create "b"
+(dir-dentry) open "b"
+(dir-dentry) "b" is 20 bytes long
+(dir-dentry) open "c" (must return -1)
+(dir-dentry) create "c"
+(dir-dentry) open "c"
+(dir-dentry) "c" is 300 bytes long
+(dir-dentry) remove "c"
+(dir-dentry) open "c" (must return -1)
+(dir-dentry) create "c"
+(dir-dentry) open "c"
+(dir-dentry) "c" is 30 bytes long
+(dir-dentry) open "d" (must return -1)
+(dir-dentry) create "d"
+(dir-dentry) open "d"
+(dir-dentry) "d" is 400 bytes long
+(dir-dentry) remove "d"
+(dir-dentry) open "d" (must return -1)
+(dir-dentry) create "d"
+(dir-dentry) open "d"
+(dir-dentry) "d" is 40 bytes long
+(dir-dentry) creating f0 through f299...
+(dir-dentry) removing even ones...
+(dir-dentry) creating even ones again...
+(dir-dentry) removing f0 through f299...
+(dir-dentry) end
+EOF
+pass;
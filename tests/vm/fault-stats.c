@@ -0,0 +1,112 @@
+/* Triggers a page fault of each class and checks that the
+   SYS_FAULT_STATS counters saw it: the calling process's counters
+   for valid faults, the global ones for an invalid fault, which
+   kills the child that takes it. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+
+/* More pages than the 64 that the test runs with, so that some of
+   them are swapped out and have to be read back in. */
+#define SWAP_PAGES 96
+
+static struct fault_stats last[2];
+
+/* Checks that the counter of class CLS in SCOPE went up since the
+   last check, then remembers its new value. */
+static void
+check_counted (int scope, int cls, const char *what)
+{
+  struct fault_stats now;
+
+  if (fault_stats (scope, &now) != 0)
+    fail ("fault_stats failed");
+  if (now.cnt[cls] <= last[scope].cnt[cls])
+    fail ("%s was not counted", what);
+  msg ("%s counted", what);
+  last[scope] = now;
+}
+
+/* Touches the bottom of a buffer several pages deep in the stack. */
+static char __attribute__ ((noinline))
+grow_stack (void)
+{
+  volatile char buf[4 * PAGE_SIZE];
+
+  buf[0] = 1;
+  return buf[0];
+}
+
+void
+test_main (void)
+{
+  char *file_map = (char *) 0x10000000;
+  char *anon = (char *) 0x20000000;
+  char *swap = (char *) 0x30000000;
+  volatile char c;
+  size_t i;
+  int handle;
+  pid_t child;
+
+  CHECK (fault_stats (FAULT_STATS_PROCESS, &last[FAULT_STATS_PROCESS]) == 0,
+         "read process fault stats");
+  CHECK (fault_stats (FAULT_STATS_GLOBAL, &last[FAULT_STATS_GLOBAL]) == 0,
+         "read global fault stats");
+  CHECK (fault_stats (2, &last[FAULT_STATS_PROCESS]) == -1,
+         "unknown scope is rejected");
+
+  /* First touch of a mapped file page loads it lazily.  Once dropped,
+     the next touch reads it back from the file. */
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (mmap (file_map, PAGE_SIZE, 0, handle, 0) == file_map,
+         "mmap \"sample.txt\"");
+  c = file_map[0];
+  check_counted (FAULT_STATS_PROCESS, FAULT_LAZY_LOAD, "lazy load");
+  CHECK (madvise (file_map, PAGE_SIZE, MADV_DONTNEED) == 0,
+         "madvise (MADV_DONTNEED)");
+  if (memcmp (file_map, sample, strlen (sample)))
+    fail ("file page read back wrong");
+  check_counted (FAULT_STATS_PROCESS, FAULT_FILE_IN, "file-in");
+
+  /* Writing untouched anonymous memory fills a frame with zeros.
+     Reading it maps the zero page, which a write then breaks. */
+  CHECK (mmap (anon, 2 * PAGE_SIZE, 1, MAP_ANONYMOUS, 0) == anon,
+         "mmap anonymous memory");
+  anon[0] = 'a';
+  check_counted (FAULT_STATS_PROCESS, FAULT_ZERO_FILL, "zero-fill");
+  c = anon[PAGE_SIZE];
+  anon[PAGE_SIZE] = 'b';
+  check_counted (FAULT_STATS_PROCESS, FAULT_COW, "copy-on-write");
+
+  c = grow_stack ();
+  check_counted (FAULT_STATS_PROCESS, FAULT_STACK_GROWTH, "stack growth");
+
+  /* Fill more anonymous memory than fits, then read it all back. */
+  CHECK (mmap (swap, SWAP_PAGES * PAGE_SIZE, 1, MAP_ANONYMOUS, 0) == swap,
+         "mmap %d anonymous pages", SWAP_PAGES);
+  for (i = 0; i < SWAP_PAGES; i++)
+    memset (swap + i * PAGE_SIZE, i, PAGE_SIZE);
+  for (i = 0; i < SWAP_PAGES; i++)
+    if (swap[i * PAGE_SIZE] != (char) i
+        || swap[i * PAGE_SIZE + PAGE_SIZE - 1] != (char) i)
+      fail ("page %zu read back wrong", i);
+  check_counted (FAULT_STATS_PROCESS, FAULT_SWAP_IN, "swap-in");
+
+  /* An invalid access kills the child, so only the global counters
+     can show it. */
+  child = fork ("child");
+  if (child == 0)
+    {
+      c = *(volatile char *) NULL;
+      exit (0);
+    }
+  CHECK (child != PID_ERROR, "fork child");
+  CHECK (wait (child) == -1, "child died of its invalid access");
+  check_counted (FAULT_STATS_GLOBAL, FAULT_INVALID, "invalid access");
+  (void) c;
+}
@@ -0,0 +1,26 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, IGNORE_USER_FAULTS => 1, [<<'EOF']);
+(fault-stats) begin
+(fault-stats) read process fault stats
+(fault-stats) read global fault stats
+(fault-stats) unknown scope is rejected
+(fault-stats) open "sample.txt"
+(fault-stats) mmap "sample.txt"
+(fault-stats) lazy load counted
+(fault-stats) madvise (MADV_DONTNEED)
+(fault-stats) file-in counted
+(fault-stats) mmap anonymous memory
+(fault-stats) zero-fill counted
+(fault-stats) copy-on-write counted
+(fault-stats) stack growth counted
+(fault-stats) mmap 96 anonymous pages
+(fault-stats) swap-in counted
+(fault-stats) fork child
+(fault-stats) child died of its invalid access
+(fault-stats) invalid access counted
+(fault-stats) end
+EOF
+pass;
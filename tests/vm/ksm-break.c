@@ -0,0 +1,84 @@
+/* Fills several anonymous pages with the same bytes, gives ksmd idle time
+   to merge them by reading a large file, then writes into one of them
+   both from user mode and through read().  Each write must break the
+   page away from the shared frame and leave the other pages untouched. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 8
+
+static char scratch[PAGE_SIZE];
+
+/* Returns true if some two of the PAGE_CNT pages at BUF share a frame. */
+static bool
+any_merged (char *buf)
+{
+  size_t i, j;
+
+  for (i = 0; i < PAGE_CNT; i++)
+    for (j = i + 1; j < PAGE_CNT; j++)
+      if (get_phys_addr (buf + i * PAGE_SIZE)
+          == get_phys_addr (buf + j * PAGE_SIZE))
+        return true;
+  return false;
+}
+
+static void
+check_pattern (const char *page, size_t idx)
+{
+  size_t i;
+
+  for (i = 0; i < PAGE_SIZE; i++)
+    if (page[i] != (char) (i % 251))
+      fail ("byte %zu of page %zu has value %02hhx (should be %02hhx)",
+            i, idx, page[i], (char) (i % 251));
+}
+
+void
+test_main (void)
+{
+  char *buf = (char *) 0x10000000;
+  size_t i;
+  int handle;
+
+  CHECK (mmap (buf, PAGE_CNT * PAGE_SIZE, 1, MAP_ANONYMOUS, 0) == buf,
+         "mmap anonymous memory");
+  for (i = 0; i < PAGE_CNT * PAGE_SIZE; i++)
+    buf[i] = i % PAGE_SIZE % 251;
+
+  /* ksmd only runs while every other thread is blocked, so wait on disk
+     reads until it has merged some of the pages, or the file runs out.
+     The rest of the test holds whether or not it got to them. */
+  CHECK ((handle = open ("large.txt")) > 1, "open \"large.txt\"");
+  while (!any_merged (buf) && read (handle, scratch, sizeof scratch) > 0)
+    continue;
+  close (handle);
+
+  /* User-mode write. */
+  buf[0] = 'x';
+  if (buf[0] != 'x')
+    fail ("write to page 0 was lost");
+  for (i = 1; i < PAGE_CNT; i++)
+    check_pattern (buf + i * PAGE_SIZE, i);
+  msg ("write from user mode");
+
+  /* Kernel-mode write. */
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (read (handle, buf + PAGE_SIZE, strlen (sample))
+         == (int) strlen (sample), "read \"sample.txt\" into page 1");
+  close (handle);
+  if (memcmp (buf + PAGE_SIZE, sample, strlen (sample)))
+    fail ("read into page 1 reported bad data");
+  for (i = 2; i < PAGE_CNT; i++)
+    check_pattern (buf + i * PAGE_SIZE, i);
+
+  for (i = 0; i < PAGE_CNT; i++)
+    if (i != 1 && get_phys_addr (buf + i * PAGE_SIZE)
+        == get_phys_addr (buf + PAGE_SIZE))
+      fail ("page 1 still shares a frame with page %zu", i);
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(ksm-break) begin
+(ksm-break) mmap anonymous memory
+(ksm-break) open "large.txt"
+(ksm-break) write from user mode
+(ksm-break) open "sample.txt"
+(ksm-break) read "sample.txt" into page 1
+(ksm-break) end
+EOF
+pass;
@@ -0,0 +1,111 @@
+/* Gives each kind of advice on anonymous, file-backed and stack
+   memory.  Advice other than MADV_DONTNEED must leave the data
+   alone.  MADV_DONTNEED must make anonymous memory read as zeros,
+   keep what was written to a file mapping, and leave a dropped stack
+   page usable.  Bad arguments must be rejected. */
+
+#include <round.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 4
+
+static char page[PAGE_SIZE];
+
+/* Fills the PAGE_CNT pages at P with a pattern based on SEED. */
+static void
+fill (char *p, int seed)
+{
+  size_t i;
+
+  for (i = 0; i < PAGE_CNT * PAGE_SIZE; i++)
+    p[i] = i * 7 + seed;
+}
+
+/* Checks that the PAGE_CNT pages at P hold fill (P, SEED)'s pattern. */
+static void
+check_fill (const char *p, int seed, const char *what)
+{
+  size_t i;
+
+  for (i = 0; i < PAGE_CNT * PAGE_SIZE; i++)
+    if (p[i] != (char) (i * 7 + seed))
+      fail ("byte %zu of %s changed", i, what);
+}
+
+/* Writes the bottom of a buffer several pages deep in the stack and
+   returns the page it wrote, which is unused once this returns. */
+static char * __attribute__ ((noinline))
+use_stack (void)
+{
+  volatile char buf[3 * PAGE_SIZE];
+
+  buf[0] = 1;
+  return (char *) ROUND_DOWN ((uintptr_t) buf, PAGE_SIZE);
+}
+
+void
+test_main (void)
+{
+  static const int advice[] = {
+    MADV_NORMAL, MADV_RANDOM, MADV_SEQUENTIAL, MADV_WILLNEED,
+  };
+  char *anon = (char *) 0x10000000;
+  char *map = (char *) 0x20000000;
+  char *stack;
+  size_t i;
+  int handle;
+
+  CHECK (mmap (anon, PAGE_CNT * PAGE_SIZE, 1, MAP_ANONYMOUS, 0) == anon,
+         "mmap anonymous memory");
+  fill (anon, 1);
+  for (i = 0; i < sizeof advice / sizeof *advice; i++)
+    if (madvise (anon, PAGE_CNT * PAGE_SIZE, advice[i]) != 0)
+      fail ("madvise (%d) failed", advice[i]);
+  check_fill (anon, 1, "anonymous memory");
+  msg ("advice kept anonymous memory");
+
+  CHECK (madvise (anon, PAGE_SIZE, 99) == -1, "unknown advice is rejected");
+  CHECK (madvise (anon + 1, PAGE_SIZE, MADV_NORMAL) == -1,
+         "misaligned address is rejected");
+  CHECK (madvise (anon, 0, MADV_NORMAL) == -1, "empty range is rejected");
+  CHECK (madvise (anon, (PAGE_CNT + 1) * PAGE_SIZE, MADV_NORMAL) == -1,
+         "range past the mapping is rejected");
+
+  CHECK (madvise (anon + PAGE_SIZE, 2 * PAGE_SIZE, MADV_DONTNEED) == 0,
+         "madvise (MADV_DONTNEED) on anonymous memory");
+  for (i = PAGE_SIZE; i < 3 * PAGE_SIZE; i++)
+    if (anon[i] != 0)
+      fail ("byte %zu of dropped memory is not zero", i);
+  if (anon[0] != 1 || anon[3 * PAGE_SIZE] != (char) (3 * PAGE_SIZE * 7 + 1))
+    fail ("pages outside the range were dropped");
+  anon[PAGE_SIZE] = 'x';
+  CHECK (anon[PAGE_SIZE] == 'x', "dropped memory is writable");
+
+  CHECK (create ("data", PAGE_CNT * PAGE_SIZE), "create \"data\"");
+  CHECK ((handle = open ("data")) > 1, "open \"data\"");
+  CHECK (mmap (map, PAGE_CNT * PAGE_SIZE, 1, handle, 0) == map,
+         "mmap \"data\"");
+  fill (map, 2);
+  for (i = 0; i < sizeof advice / sizeof *advice; i++)
+    if (madvise (map, PAGE_CNT * PAGE_SIZE, advice[i]) != 0)
+      fail ("madvise (%d) failed", advice[i]);
+  CHECK (madvise (map, PAGE_CNT * PAGE_SIZE, MADV_DONTNEED) == 0,
+         "madvise (MADV_DONTNEED) on \"data\"");
+  check_fill (map, 2, "mapped file");
+  seek (handle, 0);
+  CHECK (read (handle, page, PAGE_SIZE) == PAGE_SIZE, "read \"data\"");
+  if (memcmp (page, map, PAGE_SIZE))
+    fail ("\"data\" does not hold what was written to its mapping");
+  munmap (map);
+  close (handle);
+
+  stack = use_stack ();
+  CHECK (madvise (stack, PAGE_SIZE, MADV_DONTNEED) == 0,
+         "madvise (MADV_DONTNEED) on the stack");
+  use_stack ();
+  msg ("stack still usable");
+}
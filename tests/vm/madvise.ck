@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madvise) begin
+(madvise) mmap anonymous memory
+(madvise) advice kept anonymous memory
+(madvise) unknown advice is rejected
+(madvise) misaligned address is rejected
+(madvise) empty range is rejected
+(madvise) range past the mapping is rejected
+(madvise) madvise (MADV_DONTNEED) on anonymous memory
+(madvise) dropped memory is writable
+(madvise) create "data"
+(madvise) open "data"
+(madvise) mmap "data"
+(madvise) madvise (MADV_DONTNEED) on "data"
+(madvise) read "data"
+(madvise) madvise (MADV_DONTNEED) on the stack
+(madvise) stack still usable
+(madvise) end
+EOF
+pass;
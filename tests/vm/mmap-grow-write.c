@@ -0,0 +1,50 @@
+/* Maps the short tail of a file, extends the file with write() before
+   touching the mapping, then writes through the mapping.  The bytes the
+   mapping wrote over the new part of the file must reach the file, both
+   while it is mapped and after it is unmapped. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define OLD_LENGTH 100
+
+static char buf[PAGE_SIZE];
+
+/* Checks that "grow" holds PAGE_SIZE bytes of 'y'. */
+static void
+check_data (const char *when)
+{
+  int handle;
+  size_t i;
+
+  CHECK ((handle = open ("grow")) > 1, "open \"grow\" %s", when);
+  CHECK (read (handle, buf, PAGE_SIZE) == PAGE_SIZE, "read \"grow\" %s", when);
+  for (i = 0; i < PAGE_SIZE; i++)
+    if (buf[i] != 'y')
+      fail ("byte %zu of \"grow\" has value %02hhx (should be 'y')",
+            i, buf[i]);
+  close (handle);
+}
+
+void
+test_main (void)
+{
+  char *map = (char *) 0x10000000;
+  int handle;
+
+  CHECK (create ("grow", OLD_LENGTH), "create \"grow\"");
+  CHECK ((handle = open ("grow")) > 1, "open \"grow\"");
+  CHECK (mmap (map, PAGE_SIZE, 1, handle, 0) != MAP_FAILED, "mmap \"grow\"");
+
+  seek (handle, PAGE_SIZE - 1);
+  CHECK (write (handle, "", 1) == 1, "extend \"grow\" to a page");
+  memset (map, 'y', PAGE_SIZE);
+  check_data ("while mapped");
+
+  munmap (map);
+  close (handle);
+  check_data ("after munmap");
+}
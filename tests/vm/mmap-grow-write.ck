@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-grow-write) begin
+(mmap-grow-write) create "grow"
+(mmap-grow-write) open "grow"
+(mmap-grow-write) mmap "grow"
+(mmap-grow-write) extend "grow" to a page
+(mmap-grow-write) open "grow" while mapped
+(mmap-grow-write) read "grow" while mapped
+(mmap-grow-write) open "grow" after munmap
+(mmap-grow-write) read "grow" after munmap
+(mmap-grow-write) end
+EOF
+pass;
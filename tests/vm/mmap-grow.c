@@ -0,0 +1,42 @@
+/* Writes through a mapping past the end of a file, then extends the file
+   with write().  What the mapping wrote past the old end never became
+   part of the file, so the new part of the file must read as zeros, both
+   through read() and through the mapping. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define OLD_LENGTH 100
+#define NEW_LENGTH (2 * PAGE_SIZE)
+
+static char buf[NEW_LENGTH];
+
+void
+test_main (void)
+{
+  char *map = (char *) 0x10000000;
+  int handle;
+  size_t i;
+
+  CHECK (create ("grow", OLD_LENGTH), "create \"grow\"");
+  CHECK ((handle = open ("grow")) > 1, "open \"grow\"");
+  CHECK (mmap (map, NEW_LENGTH, 1, handle, 0) != MAP_FAILED, "mmap \"grow\"");
+  memset (map + OLD_LENGTH, 'x', NEW_LENGTH - OLD_LENGTH);
+
+  seek (handle, NEW_LENGTH - 1);
+  CHECK (write (handle, "", 1) == 1, "extend \"grow\" to two pages");
+  seek (handle, 0);
+  CHECK (read (handle, buf, NEW_LENGTH) == NEW_LENGTH, "read \"grow\"");
+  for (i = 0; i < NEW_LENGTH; i++)
+    if (buf[i] != 0)
+      fail ("byte %zu of \"grow\" has value %02hhx (should be 0)", i, buf[i]);
+  for (i = 0; i < NEW_LENGTH; i++)
+    if (map[i] != 0)
+      fail ("byte %zu of mapping has value %02hhx (should be 0)", i, map[i]);
+
+  munmap (map);
+  close (handle);
+}
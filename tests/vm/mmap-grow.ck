@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-grow) begin
+(mmap-grow) create "grow"
+(mmap-grow) open "grow"
+(mmap-grow) mmap "grow"
+(mmap-grow) extend "grow" to two pages
+(mmap-grow) read "grow"
+(mmap-grow) end
+EOF
+pass;
@@ -0,0 +1,94 @@
+/* Writes to a file mapping and flushes it with msync(), both with
+   MS_SYNC and MS_ASYNC, checking that read() then sees the new data
+   and that the mapping stays usable.  read() is served from the same
+   page cache as the mapping, so whether MS_SYNC wrote the pages out
+   is checked in the cache's statistics.  Ranges that are not
+   file-backed are skipped; bad flags, misaligned addresses and
+   unmapped ranges must be rejected. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 2
+
+static char buf[PAGE_CNT * PAGE_SIZE];
+
+/* Returns how many pages the page cache has written back so far. */
+static unsigned long long
+pages_written (void)
+{
+  struct cache_stats stats;
+
+  if (cache_stats (&stats) != 0)
+    fail ("cache_stats failed");
+  return stats.written;
+}
+
+/* Checks that the file open as HANDLE holds the same bytes as MAP. */
+static void
+check_data (int handle, const char *map)
+{
+  seek (handle, 0);
+  if (read (handle, buf, sizeof buf) != sizeof buf)
+    fail ("read \"data\" failed");
+  if (memcmp (buf, map, sizeof buf))
+    fail ("\"data\" does not hold what was written to its mapping");
+}
+
+void
+test_main (void)
+{
+  char *map = (char *) 0x10000000;
+  char *anon = (char *) 0x20000000;
+  unsigned long long written;
+  int handle;
+
+  CHECK (create ("data", sizeof buf), "create \"data\"");
+  CHECK ((handle = open ("data")) > 1, "open \"data\"");
+  CHECK (mmap (map, sizeof buf, 1, handle, 0) == map, "mmap \"data\"");
+
+  memset (map, 'a', sizeof buf);
+  written = pages_written ();
+  CHECK (msync (map, sizeof buf, MS_SYNC) == 0, "msync (MS_SYNC)");
+  CHECK (pages_written () >= written + PAGE_CNT,
+         "msync (MS_SYNC) wrote both pages back");
+  check_data (handle, map);
+
+  memset (map + PAGE_SIZE, 'b', PAGE_SIZE);
+  written = pages_written ();
+  CHECK (msync (map + PAGE_SIZE, PAGE_SIZE, MS_SYNC) == 0,
+         "msync (MS_SYNC) on the second page");
+  CHECK (pages_written () >= written + 1, "msync (MS_SYNC) wrote it back");
+  check_data (handle, map);
+
+  memset (map, 'c', PAGE_SIZE);
+  CHECK (msync (map, sizeof buf, MS_ASYNC) == 0, "msync (MS_ASYNC)");
+  CHECK (msync (map, 0, MS_SYNC) == 0, "msync of nothing");
+  check_data (handle, map);
+
+  CHECK (mmap (anon, PAGE_SIZE, 1, MAP_ANONYMOUS, 0) == anon,
+         "mmap anonymous memory");
+  anon[0] = 'x';
+  CHECK (msync (anon, PAGE_SIZE, MS_SYNC) == 0,
+         "msync skips anonymous memory");
+
+  CHECK (msync (map, sizeof buf, 0) == -1, "no flags are rejected");
+  CHECK (msync (map, sizeof buf, MS_SYNC | MS_ASYNC) == -1,
+         "both flags are rejected");
+  CHECK (msync (map + 1, PAGE_SIZE, MS_SYNC) == -1,
+         "misaligned address is rejected");
+  CHECK (msync (map, sizeof buf + PAGE_SIZE, MS_SYNC) == -1,
+         "range past the mapping is rejected");
+
+  munmap (map);
+  CHECK (msync (map, sizeof buf, MS_SYNC) == -1,
+         "unmapped range is rejected");
+  seek (handle, 0);
+  CHECK (read (handle, buf, sizeof buf) == sizeof buf, "read \"data\"");
+  if (buf[0] != 'c' || buf[PAGE_SIZE] != 'b')
+    fail ("\"data\" lost its contents at munmap");
+  close (handle);
+}
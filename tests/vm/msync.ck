@@ -0,0 +1,26 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(msync) begin
+(msync) create "data"
+(msync) open "data"
+(msync) mmap "data"
+(msync) msync (MS_SYNC)
+(msync) msync (MS_SYNC) wrote both pages back
+(msync) msync (MS_SYNC) on the second page
+(msync) msync (MS_SYNC) wrote it back
+(msync) msync (MS_ASYNC)
+(msync) msync of nothing
+(msync) mmap anonymous memory
+(msync) msync skips anonymous memory
+(msync) no flags are rejected
+(msync) both flags are rejected
+(msync) misaligned address is rejected
+(msync) range past the mapping is rejected
+(msync) unmapped range is rejected
+(msync) read "data"
+(msync) end
+EOF
+pass;
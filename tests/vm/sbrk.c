@@ -0,0 +1,74 @@
+/* Grows and shrinks the heap with sbrk() and checks that new heap memory
+   reads as zeros, keeps what is written to it, and is given up when the
+   heap shrinks past it.  Then allocates through malloc(), which takes its
+   memory from the heap. */
+
+#include <malloc.h>
+#include <round.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 3
+#define BLOCK_CNT 64
+
+static void
+check_zeros (const char *p, size_t size)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    if (p[i] != 0)
+      fail ("heap byte %zu has value %02hhx (should be 0)", i, p[i]);
+}
+
+void
+test_main (void)
+{
+  char *start, *freed;
+  char *blocks[BLOCK_CNT];
+  size_t i;
+
+  start = sbrk (0);
+  CHECK (start != (void *) -1, "sbrk (0)");
+  CHECK (sbrk (PAGE_CNT * PAGE_SIZE) == start, "grow heap by 3 pages");
+  CHECK (sbrk (0) == start + PAGE_CNT * PAGE_SIZE, "break moved");
+  check_zeros (start, PAGE_CNT * PAGE_SIZE);
+  for (i = 0; i < PAGE_CNT * PAGE_SIZE; i++)
+    start[i] = i % 251;
+  for (i = 0; i < PAGE_CNT * PAGE_SIZE; i++)
+    if (start[i] != (char) (i % 251))
+      fail ("heap byte %zu has wrong value", i);
+
+  /* The pages past the lower break are freed, and come back as zeros. */
+  freed = (char *) ROUND_UP ((uintptr_t) start + PAGE_SIZE, PAGE_SIZE);
+  CHECK (sbrk (-2 * PAGE_SIZE) == start + PAGE_CNT * PAGE_SIZE,
+         "shrink heap by 2 pages");
+  CHECK (sbrk (2 * PAGE_SIZE) == start + PAGE_SIZE, "grow it back");
+  check_zeros (freed, start + PAGE_CNT * PAGE_SIZE - freed);
+  CHECK (sbrk (-PAGE_CNT * PAGE_SIZE) == start + PAGE_CNT * PAGE_SIZE,
+         "shrink heap to its start");
+
+  CHECK (sbrk (-PAGE_SIZE) == (void *) -1, "shrinking below start fails");
+  CHECK (sbrk (0) == start, "break unchanged");
+
+  for (i = 0; i < BLOCK_CNT; i++)
+    {
+      blocks[i] = malloc (100 + i * 37);
+      if (blocks[i] == NULL)
+        fail ("malloc %zu failed", i);
+      memset (blocks[i], i, 100 + i * 37);
+    }
+  for (i = 0; i < BLOCK_CNT; i++)
+    {
+      size_t j;
+
+      for (j = 0; j < 100 + i * 37; j++)
+        if (blocks[i][j] != (char) i)
+          fail ("block %zu byte %zu was overwritten", i, j);
+      free (blocks[i]);
+    }
+  msg ("malloc and free %d blocks", BLOCK_CNT);
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sbrk) begin
+(sbrk) sbrk (0)
+(sbrk) grow heap by 3 pages
+(sbrk) break moved
+(sbrk) shrink heap by 2 pages
+(sbrk) grow it back
+(sbrk) shrink heap to its start
+(sbrk) shrinking below start fails
+(sbrk) break unchanged
+(sbrk) malloc and free 64 blocks
+(sbrk) end
+EOF
+pass;
@@ -0,0 +1,59 @@
+/* Reads untouched anonymous memory, which is backed by the shared zero
+   page, then has the kernel read() a file into one of those pages.  The
+   kernel's write must give that page a frame of its own and leave the
+   others reading as zeros. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 3
+
+static void
+check_zeros (const char *page, const char *name)
+{
+  size_t i;
+
+  for (i = 0; i < PAGE_SIZE; i++)
+    if (page[i] != 0)
+      fail ("byte %zu of %s has value %02hhx (should be 0)",
+            i, name, page[i]);
+}
+
+void
+test_main (void)
+{
+  char *buf = (char *) 0x10000000;
+  size_t i;
+  int handle;
+
+  CHECK (mmap (buf, PAGE_CNT * PAGE_SIZE, 1, MAP_ANONYMOUS, 0) == buf,
+         "mmap anonymous memory");
+  for (i = 0; i < PAGE_CNT; i++)
+    check_zeros (buf + i * PAGE_SIZE, "fresh page");
+  CHECK (get_phys_addr (buf) == get_phys_addr (buf + PAGE_SIZE),
+         "untouched pages share a frame");
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (read (handle, buf + PAGE_SIZE, strlen (sample))
+         == (int) strlen (sample), "read \"sample.txt\" into second page");
+  close (handle);
+
+  if (memcmp (buf + PAGE_SIZE, sample, strlen (sample)))
+    fail ("read into zero page reported bad data");
+  CHECK (get_phys_addr (buf) != get_phys_addr (buf + PAGE_SIZE),
+         "written page has a frame of its own");
+  check_zeros (buf, "first page");
+  check_zeros (buf + 2 * PAGE_SIZE, "third page");
+
+  buf[2 * PAGE_SIZE] = 'x';
+  check_zeros (buf, "first page");
+
+  /* A fresh mapping must still see zeros. */
+  CHECK (mmap (buf + PAGE_CNT * PAGE_SIZE, PAGE_SIZE, 0, MAP_ANONYMOUS, 0)
+         != MAP_FAILED, "mmap another anonymous page");
+  check_zeros (buf + PAGE_CNT * PAGE_SIZE, "new page");
+}
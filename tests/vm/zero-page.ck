@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(zero-page) begin
+(zero-page) mmap anonymous memory
+(zero-page) untouched pages share a frame
+(zero-page) open "sample.txt"
+(zero-page) read "sample.txt" into second page
+(zero-page) written page has a frame of its own
+(zero-page) mmap another anonymous page
+(zero-page) end
+EOF
+pass;
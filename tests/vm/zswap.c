@@ -0,0 +1,74 @@
+/* Fills more anonymous memory than the test's 64 user pages can
+   hold, alternating pages that compress well with random ones that
+   do not, and reads it all back.  The compressed swap cache is kept
+   small, so pages must go through it, past it to the swap disk, and
+   from it to the disk when it fills up. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 160
+
+static char expected[PAGE_SIZE];
+
+/* Stores what page I holds after round ROUND into expected[]. */
+static void
+make_page (size_t i, int round)
+{
+  size_t j;
+
+  if (i % 2 == 0)
+    for (j = 0; j < PAGE_SIZE; j++)
+      expected[j] = "compressible"[(i + j) % 12] + round;
+  else
+    {
+      random_init (i * 2 + round);
+      random_bytes (expected, PAGE_SIZE);
+    }
+}
+
+/* Checks every page at BUF, every third one of which has been
+   rewritten in round 1 if REWRITTEN. */
+static void
+check_pages (const char *buf, bool rewritten)
+{
+  size_t i;
+
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      make_page (i, rewritten && i % 3 == 0);
+      if (memcmp (buf + i * PAGE_SIZE, expected, PAGE_SIZE))
+        fail ("page %zu read back wrong", i);
+    }
+}
+
+void
+test_main (void)
+{
+  char *buf = (char *) 0x10000000;
+  size_t i;
+
+  CHECK (mmap (buf, PAGE_CNT * PAGE_SIZE, 1, MAP_ANONYMOUS, 0) == buf,
+         "mmap %d anonymous pages", PAGE_CNT);
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      make_page (i, 0);
+      memcpy (buf + i * PAGE_SIZE, expected, PAGE_SIZE);
+    }
+  msg ("wrote every page");
+  check_pages (buf, false);
+  msg ("read every page back");
+
+  /* Rewrite every third page, so that some swapped copies go stale. */
+  for (i = 0; i < PAGE_CNT; i += 3)
+    {
+      make_page (i, 1);
+      memcpy (buf + i * PAGE_SIZE, expected, PAGE_SIZE);
+    }
+  check_pages (buf, true);
+  msg ("read every page back after rewriting some");
+}
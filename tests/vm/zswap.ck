@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(zswap) begin
+(zswap) mmap 160 anonymous pages
+(zswap) wrote every page
+(zswap) read every page back
+(zswap) read every page back after rewriting some
+(zswap) end
+EOF
+pass;
@@ -31,10 +31,20 @@
 #include "tests/threads/tests.h"
 #ifdef VM
 #include "vm/vm.h"
+#include "vm/ksm.h"
+#include "vm/kswapd.h"
+#include "vm/reaper.h"
+#include "vm/fault.h"
+#include "vm/zswap.h"
 #endif
 #ifdef FILESYS
 #include "devices/disk.h"
+#include "filesys/buffer_cache.h"
+#include "filesys/dentry.h"
 #include "filesys/filesys.h"
+#ifdef EFILESYS
+#include "filesys/fat.h"
+#endif
 #include "filesys/fsutil.h"
 #endif
 
@@ -155,7 +165,9 @@ paging_init (uint64_t mem_end) {
 	for (uint64_t pa = 0; pa < mem_end; pa += PGSIZE) {
 		uint64_t va = (uint64_t) ptov(pa);
 
-		perm = PTE_P | PTE_W;
+		/* The kernel mapping is the same in every page table, so its TLB
+		 * entries survive switches between them. */
+		perm = PTE_P | PTE_W | PTE_G;
 		if ((uint64_t) &start <= va && va < (uint64_t) &_end_kernel_text)
 			perm &= ~PTE_W;
 
@@ -165,6 +177,7 @@ paging_init (uint64_t mem_end) {
 
 	// reload cr3
 	pml4_activate(0);
+	tlb_init ();
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -216,6 +229,12 @@ parse_options (char **argv) {
 #ifdef FILESYS
 		else if (!strcmp (name, "-f"))
 			format_filesys = true;
+		else if (!strcmp (name, "-bc"))
+			buffer_cache_size = atoi (value);
+#endif
+#ifdef EFILESYS
+		else if (!strcmp (name, "-cs"))
+			fat_format_cluster_sectors = atoi (value);
 #endif
 		else if (!strcmp (name, "-rs"))
 			random_init (atoi (value));
@@ -226,6 +245,18 @@ parse_options (char **argv) {
 			user_page_limit = atoi (value);
 		else if (!strcmp (name, "-threads-tests"))
 			thread_tests = true;
+#endif
+#ifdef VM
+		else if (!strcmp (name, "-fa"))
+			vm_fault_around_max = atoi (value);
+		else if (!strcmp (name, "-ksm"))
+			ksm_enabled = true;
+		else if (!strcmp (name, "-zswap"))
+			zswap_pages = atoi (value);
+		else if (!strcmp (name, "-rss"))
+			vm_rss_limit = atoi (value);
+		else if (!strcmp (name, "-kswapd"))
+			kswapd_low = atoi (value);
 #endif
 		else
 			PANIC ("unknown option `%s' (use -h for help)", name);
@@ -324,10 +355,23 @@ usage (void) {
 			"  -h                 Print this help message and power off.\n"
 			"  -q                 Power off VM after actions or on panic.\n"
 			"  -f                 Format file system disk during startup.\n"
+#ifdef FILESYS
+			"  -bc=SECTORS        Cache SECTORS disk sectors, 0 for none.\n"
+#endif
+#ifdef EFILESYS
+			"  -cs=SECTORS        Format with clusters of SECTORS sectors.\n"
+#endif
 			"  -rs=SEED           Set random number seed to SEED.\n"
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+			"  -fa=PAGES          Map up to PAGES pages around file faults.\n"
+			"  -ksm               Merge identical anonymous pages in background.\n"
+			"  -zswap=PAGES       Compress swapped pages into PAGES kernel pages.\n"
+			"  -rss=PAGES         Limit each process to PAGES resident pages.\n"
+			"  -kswapd=PAGES      Page out in background below PAGES free frames.\n"
 #endif
 			);
 	power_off ();
@@ -354,12 +398,24 @@ static void
 print_stats (void) {
 	timer_print_stats ();
 	thread_print_stats ();
+#ifdef VM
+	fault_print_stats ();
+#endif
 #ifdef FILESYS
 	disk_print_stats ();
+	buffer_cache_print_stats ();
+	dentry_print_stats ();
 #endif
 	console_print_stats ();
 	kbd_print_stats ();
 #ifdef USERPROG
 	exception_print_stats ();
 #endif
+#ifdef VM
+	ksm_print_stats ();
+	zswap_print_stats ();
+	kswapd_print_stats ();
+	reaper_print_stats ();
+	page_cache_print_stats ();
+#endif
 }
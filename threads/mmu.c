@@ -2,12 +2,41 @@
 #include <stddef.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
 #include "intrinsic.h"
 
+/* Process-context identifiers.  With CR4.PCIDE set, the low bits of CR3
+ * hold a PCID, and the TLB tags each entry with the PCID it was loaded
+ * under, so switching page tables does not have to flush it.  PCID 0 is
+ * the kernel's; user page tables are handed one of the others when they
+ * are activated, taking it from its oldest holder once all are in use. */
+#define PCID_CNT 64
+#define CR3_NOFLUSH (1ULL << 63)    /* Keep TLB entries of the new PCID. */
+#define CR4_PGE (1 << 7)            /* Global pages. */
+#define CR4_PCIDE (1 << 17)         /* Process-context identifiers. */
+#define CPUID_1_EDX_PGE (1 << 13)
+#define CPUID_1_ECX_PCID (1 << 17)
+#define CPUID_7_EBX_INVPCID (1 << 10)
+#define INVPCID_ADDR 0              /* Invalidate one address of one PCID. */
+
+/* A PCID and the page table it is assigned to. */
+struct asid {
+	uint64_t *pml4;                 /* Page table, or NULL if unassigned. */
+	bool stale;                     /* Flush its TLB entries on next load? */
+};
+
+static bool pcid_enabled;
+static bool invpcid_enabled;
+static struct asid asids[PCID_CNT];
+static unsigned asid_next = 1;      /* Next PCID to hand out. */
+
+static unsigned asid_find (uint64_t *pml4);
+static void tlb_flush_page (uint64_t *pml4, const void *vpage);
+
 static uint64_t *
 pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
 	int idx = PDX (va);
@@ -192,6 +221,16 @@ pml4_destroy (uint64_t *pml4) {
 		return;
 	ASSERT (pml4 != base_pml4);
 
+	/* The next holder of the PCID flushes what is left of this page
+	 * table in the TLB. */
+	if (pcid_enabled) {
+		enum intr_level old_level = intr_disable ();
+		unsigned pcid = asid_find (pml4);
+		if (pcid != 0)
+			asids[pcid].pml4 = NULL;
+		intr_set_level (old_level);
+	}
+
 	/* if PML4 (vaddr) >= 1, it's kernel space by define. */
 	uint64_t *pdpe = ptov ((uint64_t *) pml4[0]);
 	if (((uint64_t) pdpe) & PTE_P)
@@ -200,10 +239,93 @@ pml4_destroy (uint64_t *pml4) {
 }
 
 /* Loads page directory PD into the CPU's page directory base
- * register. */
+ * register.  With PCIDs, the TLB entries of PD are kept from the last
+ * time it was active unless its PCID was reassigned or marked stale in
+ * the meantime. */
 void
 pml4_activate (uint64_t *pml4) {
-	lcr3 (vtop (pml4 ? pml4 : base_pml4));
+	enum intr_level old_level;
+	uint64_t cr3;
+	unsigned pcid;
+	bool flush = false;
+
+	if (pml4 == NULL)
+		pml4 = base_pml4;
+	cr3 = vtop (pml4);
+	if (!pcid_enabled) {
+		lcr3 (cr3);
+		return;
+	}
+
+	old_level = intr_disable ();
+	if (pml4 != base_pml4) {
+		pcid = asid_find (pml4);
+		if (pcid == 0) {
+			pcid = asid_next;
+			asid_next = asid_next % (PCID_CNT - 1) + 1;
+			asids[pcid].pml4 = pml4;
+			flush = true;
+		} else if (asids[pcid].stale)
+			flush = true;
+		asids[pcid].stale = false;
+		cr3 |= pcid;
+	}
+	lcr3 (flush ? cr3 : cr3 | CR3_NOFLUSH);
+	intr_set_level (old_level);
+}
+
+/* Returns the PCID assigned to PML4, or 0 if it has none.  Must be called
+ * with interrupts off. */
+static unsigned
+asid_find (uint64_t *pml4) {
+	unsigned pcid;
+
+	for (pcid = 1; pcid < PCID_CNT; pcid++)
+		if (asids[pcid].pml4 == pml4)
+			return pcid;
+	return 0;
+}
+
+/* Drops the TLB entry for VPAGE in PML4 after its PTE changed.  If PML4
+ * is not active, its entry can only be cached under its PCID: that is
+ * invalidated directly if the CPU has INVPCID, and otherwise the whole
+ * PCID is flushed the next time PML4 is activated. */
+static void
+tlb_flush_page (uint64_t *pml4, const void *vpage) {
+	enum intr_level old_level = intr_disable ();
+
+	if (PTE_ADDR (rcr3 ()) == vtop (pml4))
+		invlpg ((uint64_t) vpage);
+	else if (pcid_enabled) {
+		unsigned pcid = asid_find (pml4);
+		if (pcid != 0) {
+			if (invpcid_enabled)
+				invpcid (INVPCID_ADDR, pcid, (uint64_t) vpage);
+			else
+				asids[pcid].stale = true;
+		}
+	}
+	intr_set_level (old_level);
+}
+
+/* Turns on global pages and, if the CPU has them, PCIDs.  Called once the
+ * kernel page table is active. */
+void
+tlb_init (void) {
+	uint32_t max_leaf, a, b, c, d;
+
+	cpuid (0, 0, &max_leaf, &b, &c, &d);
+	cpuid (1, 0, &a, &b, &c, &d);
+	if (d & CPUID_1_EDX_PGE)
+		lcr4 (rcr4 () | CR4_PGE);
+	if (c & CPUID_1_ECX_PCID) {
+		lcr4 (rcr4 () | CR4_PCIDE);
+		pcid_enabled = true;
+		if (max_leaf >= 7) {
+			cpuid (7, 0, &a, &b, &c, &d);
+			invpcid_enabled = (b & CPUID_7_EBX_INVPCID) != 0;
+		}
+	}
 }
 
 /* Looks up the physical address that corresponds to user virtual
@@ -238,8 +360,13 @@ pml4_set_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
 
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) upage, 1);
 
-	if (pte)
+	if (pte) {
+		bool was_present = (*pte & PTE_P) != 0;
+
 		*pte = vtop (kpage) | PTE_P | (rw ? PTE_W : 0) | PTE_U;
+		if (was_present)
+			tlb_flush_page (pml4, upage);
+	}
 	return pte != NULL;
 }
 
@@ -257,8 +384,7 @@ pml4_clear_page (uint64_t *pml4, void *upage) {
 
 	if (pte != NULL && (*pte & PTE_P) != 0) {
 		*pte &= ~PTE_P;
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) upage);
+		tlb_flush_page (pml4, upage);
 	}
 }
 
@@ -283,8 +409,22 @@ pml4_set_dirty (uint64_t *pml4, const void *vpage, bool dirty) {
 		else
 			*pte &= ~(uint32_t) PTE_D;
 
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+		tlb_flush_page (pml4, vpage);
+	}
+}
+
+/* Allows writes to virtual page VPAGE in PML4 if WRITABLE, makes it
+ * read-only otherwise. */
+void
+pml4_set_writable (uint64_t *pml4, const void *vpage, bool writable) {
+	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
+	if (pte) {
+		if (writable)
+			*pte |= PTE_W;
+		else
+			*pte &= ~(uint64_t) PTE_W;
+
+		tlb_flush_page (pml4, vpage);
 	}
 }
 
@@ -309,7 +449,6 @@ pml4_set_accessed (uint64_t *pml4, const void *vpage, bool accessed) {
 		else
 			*pte &= ~(uint32_t) PTE_A;
 
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+		tlb_flush_page (pml4, vpage);
 	}
 }
@@ -427,4 +427,68 @@ void cond_broadcast(struct condition *cond, struct lock *lock)
 	ASSERT(lock != NULL);
 	while (!list_empty(&cond->waiters))
 		cond_signal(cond, lock);
-}
\ No newline at end of file
+}
+/* Initializes RW, a reader-writer lock.  Any number of readers
+   may hold it at once, or a single writer.  Readers are let in
+   whenever no writer holds it, even while writers wait, so that a
+   reader may take it again while holding it; a writer waits for
+   the readers to drain. */
+void rwlock_init(struct rwlock *rw)
+{
+	ASSERT(rw != NULL);
+
+	lock_init(&rw->lock);
+	cond_init(&rw->changed);
+	rw->readers = 0;
+	rw->writer = false;
+}
+
+/* Acquires RW for reading, sleeping until no writer holds it. */
+void rwlock_acquire_read(struct rwlock *rw)
+{
+	ASSERT(rw != NULL);
+	ASSERT(!intr_context());
+
+	lock_acquire(&rw->lock);
+	while (rw->writer)
+		cond_wait(&rw->changed, &rw->lock);
+	rw->readers++;
+	lock_release(&rw->lock);
+}
+
+/* Releases RW, held for reading. */
+void rwlock_release_read(struct rwlock *rw)
+{
+	ASSERT(rw != NULL);
+
+	lock_acquire(&rw->lock);
+	ASSERT(rw->readers > 0);
+	if (--rw->readers == 0)
+		cond_broadcast(&rw->changed, &rw->lock);
+	lock_release(&rw->lock);
+}
+
+/* Acquires RW for writing, sleeping until nobody else holds it. */
+void rwlock_acquire_write(struct rwlock *rw)
+{
+	ASSERT(rw != NULL);
+	ASSERT(!intr_context());
+
+	lock_acquire(&rw->lock);
+	while (rw->writer || rw->readers > 0)
+		cond_wait(&rw->changed, &rw->lock);
+	rw->writer = true;
+	lock_release(&rw->lock);
+}
+
+/* Releases RW, held for writing. */
+void rwlock_release_write(struct rwlock *rw)
+{
+	ASSERT(rw != NULL);
+
+	lock_acquire(&rw->lock);
+	ASSERT(rw->writer);
+	rw->writer = false;
+	cond_broadcast(&rw->changed, &rw->lock);
+	lock_release(&rw->lock);
+}
@@ -212,6 +212,7 @@ tid_t thread_create(const char *name, int priority,
 
 #ifdef USERPROG
 	/* Add to parent's child list */
+	t->parent = thread_current();
 	list_push_back(&thread_current()->child_list, &t->child_elem);
 #endif
 
@@ -446,6 +447,9 @@ init_thread(struct thread *t, const char *name, int priority)
 	list_init(&t->donations);
 #ifdef USERPROG
 	list_init(&t->child_list);
+	sema_init(&t->wait_sema, 0);
+	sema_init(&t->free_sema, 0);
+	sema_init(&t->fork_sema, 0);
 #endif
 	t->magic = THREAD_MAGIC;
 }
@@ -6,6 +6,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "userprog/gdt.h"
+#include "userprog/syscall.h"
 #include "userprog/tss.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
@@ -13,6 +14,7 @@
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
@@ -20,6 +22,7 @@
 #include "intrinsic.h"
 #ifdef VM
 #include "vm/vm.h"
+#include "vm/reaper.h"
 #endif
 
 static void process_cleanup (void);
@@ -31,6 +34,26 @@ static void __do_fork (void *);
 static void
 process_init (void) {
 	struct thread *current = thread_current ();
+
+	current->fd_table = calloc (FD_MAX, sizeof *current->fd_table);
+	if (current->fd_table == NULL)
+		thread_exit ();
+}
+
+/* Returns the child of the running thread whose tid is CHILD_TID, or NULL
+ * if there is none. */
+static struct thread *
+get_child (tid_t child_tid) {
+	struct thread *curr = thread_current ();
+	struct list_elem *e;
+
+	for (e = list_begin (&curr->child_list); e != list_end (&curr->child_list);
+			e = list_next (e)) {
+		struct thread *t = list_entry (e, struct thread, child_elem);
+		if (t->tid == child_tid)
+			return t;
+	}
+	return NULL;
 }
 
 /* Starts the first userland program, called "initd", loaded from FILE_NAME.
@@ -54,30 +77,13 @@ process_create_initd (const char *file_name) {
 	tid = thread_create (file_name, PRI_DEFAULT, initd, fn_copy);
 	if (tid == TID_ERROR)
 		palloc_free_page (fn_copy);
-
-	// 자식 스레드를 찾아 부모-자식 관계를 설정하고 세마포어를 초기화합니다.
-	struct thread *child = NULL;
-	struct list_elem *e;
-	for (e = list_begin(&thread_current()->child_list); e != list_end(&thread_current()->child_list); e = list_next(e)) {
-		struct thread *t = list_entry(e, struct thread, child_elem);
-		if (t->tid == tid) {
-			child = t;
-			child->parent = thread_current();
-			sema_init(&child->wait_sema, 0);
-			break;
-		}
-	}
-
-	if (child == NULL) { // 만약 자식을 찾지 못했다면 에러 처리
-		return TID_ERROR;
-	}
-
 	return tid;
 }
 
 /* A thread function that launches first user process. */
 static void
 initd (void *f_name) {
+	thread_current ()->is_process = true;
 #ifdef VM
 	supplemental_page_table_init (&thread_current ()->spt);
 #endif
@@ -92,10 +98,26 @@ initd (void *f_name) {
 /* Clones the current process as `name`. Returns the new process's thread id, or
  * TID_ERROR if the thread cannot be created. */
 tid_t
-process_fork (const char *name, struct intr_frame *if_ UNUSED) {
+process_fork (const char *name, struct intr_frame *if_) {
+	struct thread *child;
+	tid_t tid;
+
 	/* Clone current thread to new thread.*/
-	return thread_create (name,
+	thread_current ()->fork_if = if_;
+	tid = thread_create (name,
 			PRI_DEFAULT, __do_fork, thread_current ());
+	if (tid == TID_ERROR)
+		return TID_ERROR;
+
+	/* The child copies from our address space and our IF_, so stay put
+	 * until it is done. */
+	child = get_child (tid);
+	sema_down (&child->fork_sema);
+	if (child->exit_status == TID_ERROR) {
+		process_wait (tid);
+		return TID_ERROR;
+	}
+	return tid;
 }
 
 #ifndef VM
@@ -109,22 +131,31 @@ duplicate_pte (uint64_t *pte, void *va, void *aux) {
 	void *newpage;
 	bool writable;
 
-	/* 1. TODO: If the parent_page is kernel page, then return immediately. */
+	/* 1. If the parent_page is kernel page, then return immediately. */
+	if (is_kernel_vaddr (va))
+		return true;
 
 	/* 2. Resolve VA from the parent's page map level 4. */
 	parent_page = pml4_get_page (parent->pml4, va);
 
-	/* 3. TODO: Allocate new PAL_USER page for the child and set result to
-	 *    TODO: NEWPAGE. */
+	/* 3. Allocate new PAL_USER page for the child and set result to
+	 *    NEWPAGE. */
+	newpage = palloc_get_page (PAL_USER);
+	if (newpage == NULL)
+		return false;
 
-	/* 4. TODO: Duplicate parent's page to the new page and
-	 *    TODO: check whether parent's page is writable or not (set WRITABLE
-	 *    TODO: according to the result). */
+	/* 4. Duplicate parent's page to the new page and
+	 *    check whether parent's page is writable or not (set WRITABLE
+	 *    according to the result). */
+	memcpy (newpage, parent_page, PGSIZE);
+	writable = is_writable (pte);
 
 	/* 5. Add new page to child's page table at address VA with WRITABLE
 	 *    permission. */
 	if (!pml4_set_page (current->pml4, va, newpage, writable)) {
-		/* 6. TODO: if fail to insert page, do error handling. */
+		/* 6. if fail to insert page, do error handling. */
+		palloc_free_page (newpage);
+		return false;
 	}
 	return true;
 }
@@ -139,12 +170,31 @@ __do_fork (void *aux) {
 	struct intr_frame if_;
 	struct thread *parent = (struct thread *) aux;
 	struct thread *current = thread_current ();
-	/* TODO: somehow pass the parent_if. (i.e. process_fork()'s if_) */
-	struct intr_frame *parent_if;
+	struct intr_frame *parent_if = parent->fork_if;
 	bool succ = true;
 
+	current->is_process = true;
+	process_init ();
+
 	/* 1. Read the cpu context to local stack. */
 	memcpy (&if_, parent_if, sizeof (struct intr_frame));
+	if_.R.rax = 0;
+
+	/* Open files are duplicated first: the executable has to be in place
+	 * before the pages that are read from it are copied. */
+	lock_acquire (&filesys_lock);
+	for (int fd = 2; fd < FD_MAX && succ; fd++)
+		if (parent->fd_table[fd] != NULL) {
+			current->fd_table[fd] = file_duplicate (parent->fd_table[fd]);
+			succ = current->fd_table[fd] != NULL;
+		}
+	if (succ && parent->running_file != NULL) {
+		current->running_file = file_duplicate (parent->running_file);
+		succ = current->running_file != NULL;
+	}
+	lock_release (&filesys_lock);
+	if (!succ)
+		goto error;
 
 	/* 2. Duplicate PT */
 	current->pml4 = pml4_create();
@@ -161,18 +211,12 @@ __do_fork (void *aux) {
 		goto error;
 #endif
 
-	/* TODO: Your code goes here.
-	 * TODO: Hint) To duplicate the file object, use `file_duplicate`
-	 * TODO:       in include/filesys/file.h. Note that parent should not return
-	 * TODO:       from the fork() until this function successfully duplicates
-	 * TODO:       the resources of parent.*/
-
-	process_init ();
-
 	/* Finally, switch to the newly created process. */
-	if (succ)
-		do_iret (&if_);
+	sema_up (&current->fork_sema);
+	do_iret (&if_);
 error:
+	current->exit_status = TID_ERROR;
+	sema_up (&current->fork_sema);
 	thread_exit ();
 }
 
@@ -196,6 +240,7 @@ process_exec (void *f_name) {
 
 	/* And then load the binary */
 	success = load (file_name, &_if);
+	palloc_free_page (file_name);
 
 	/* If load failed, quit. */
 	if (!success)
@@ -217,19 +262,9 @@ process_exec (void *f_name) {
  * This function will be implemented in problem 2-2.  For now, it
  * does nothing. */
 int
-process_wait (tid_t child_tid UNUSED) {
-	struct thread *curr = thread_current();
-	struct thread *child = NULL;
-
+process_wait (tid_t child_tid) {
 	// 1. 자식 리스트에서 해당 tid를 가진 자식 스레드를 찾습니다.
-	struct list_elem *e;
-	for (e = list_begin(&curr->child_list); e != list_end(&curr->child_list); e = list_next(e)) {
-		struct thread *t = list_entry(e, struct thread, child_elem);
-		if (t->tid == child_tid) {
-			child = t;
-			break;
-		}
-	}
+	struct thread *child = get_child (child_tid);
 
 	// 자식이 없거나 이미 wait한 경우
 	if (child == NULL) {
@@ -243,6 +278,9 @@ process_wait (tid_t child_tid UNUSED) {
 	int exit_status = child->exit_status;
 	list_remove(&child->child_elem);
 
+	/* The child stays around until its status has been read. */
+	sema_up (&child->free_sema);
+
 	// 4. 자식의 종료 상태를 반환합니다.
 	return exit_status;
 }
@@ -257,11 +295,45 @@ process_exit (void) {
 	 * TODO: project2/process_termination.html).
 	 * TODO: We recommend you to implement process resource cleanup here. */
 
-	process_cleanup ();
+	/* A process killed inside a system call may still hold the lock. */
+	if (lock_held_by_current_thread (&filesys_lock))
+		lock_release (&filesys_lock);
+
+	if (curr->fd_table != NULL) {
+		lock_acquire (&filesys_lock);
+		for (int fd = 0; fd < FD_MAX; fd++)
+			file_close (curr->fd_table[fd]);
+		lock_release (&filesys_lock);
+		free (curr->fd_table);
+		curr->fd_table = NULL;
+	}
+
+	/* The parent need not wait for the address space to be freed. */
+#ifdef VM
+	if (curr->pml4 == NULL || !reaper_defer (curr))
+#endif
+		process_cleanup ();
+#ifdef VM
+	hash_destroy (&curr->spt.pages, NULL);
+#endif
+
+	/* Nobody is left to reap our children. */
+	if (curr->is_process) {
+		struct list_elem *e = list_begin (&curr->child_list);
+
+		while (e != list_end (&curr->child_list)) {
+			struct thread *child = list_entry (e, struct thread, child_elem);
+
+			/* The child may be gone as soon as it is released. */
+			e = list_next (e);
+			sema_up (&child->free_sema);
+		}
+	}
 
 	// 부모 프로세스가 기다리고 있다면 깨워줍니다.
-	if (curr->parent != NULL) {
-		sema_up(&curr->wait_sema);
+	if (curr->is_process) {
+		sema_up (&curr->wait_sema);
+		sema_down (&curr->free_sema);
 	}
 }
 
@@ -274,6 +346,10 @@ process_cleanup (void) {
 	supplemental_page_table_kill (&curr->spt);
 #endif
 
+	/* Lazily loaded segments read from the executable until now. */
+	file_close (curr->running_file);
+	curr->running_file = NULL;
+
 	uint64_t *pml4;
 	/* Destroy the current process's page directory and switch back
 	 * to the kernel-only page directory. */
@@ -371,10 +447,13 @@ load (const char *file_name, struct intr_frame *if_) {
 	struct thread *t = thread_current ();
 	struct ELF ehdr;
 	struct file *file = NULL;
+	char *file_name_copy = NULL;
 	off_t file_ofs;
 	bool success = false;
 	int i;
 
+	lock_acquire (&filesys_lock);
+
 	/* Allocate and activate page directory. */
 	t->pml4 = pml4_create ();
 	if (t->pml4 == NULL)
@@ -382,7 +461,7 @@ load (const char *file_name, struct intr_frame *if_) {
 	process_activate (thread_current ());
 
 	// strtok_r이 file_name을 변경시키므로, 파일 이름 부분을 먼저 복사합니다.
-	char *file_name_copy = palloc_get_page(0);
+	file_name_copy = palloc_get_page(0);
 	if (file_name_copy == NULL)
 		goto done;
 	strlcpy(file_name_copy, file_name, PGSIZE);
@@ -481,12 +560,19 @@ load (const char *file_name, struct intr_frame *if_) {
 	// 2. 파싱된 인자를 스택에 저장 (setup_stack에서 처리)
 	setup_stack_args(if_, argc, argv);
 
-	palloc_free_page(file_name_copy);
 	success = true;
 
+	/* Keep the executable open and unmodifiable while it runs; its
+	 * segments are paged in from it on demand. */
+	file_deny_write (file);
+	t->running_file = file;
+	file = NULL;
+
 done:
 	/* We arrive here whether the load is successful or not. */
+	palloc_free_page (file_name_copy);
 	file_close (file);
+	lock_release (&filesys_lock);
 	return success;
 }
 
@@ -681,13 +767,6 @@ install_page (void *upage, void *kpage, bool writable) {
  * If you want to implement the function for only project 2, implement it on the
  * upper block. */
 
-static bool
-lazy_load_segment (struct page *page, void *aux) {
-	/* TODO: Load the segment from the file */
-	/* TODO: This called when the first page fault occurs on address VA. */
-	/* TODO: VA is available when calling this function. */
-}
-
 /* Loads a segment starting at offset OFS in FILE at address
  * UPAGE.  In total, READ_BYTES + ZERO_BYTES bytes of virtual
  * memory are initialized, as follows:
@@ -709,6 +788,11 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 	ASSERT (pg_ofs (upage) == 0);
 	ASSERT (ofs % PGSIZE == 0);
 
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	if (vma_create (spt, upage, upage + read_bytes + zero_bytes, file, ofs,
+				writable ? VMA_WRITABLE : 0) == NULL)
+		return false;
+
 	while (read_bytes > 0 || zero_bytes > 0) {
 		/* Do calculate how to fill this page.
 		 * We will read PAGE_READ_BYTES bytes from FILE
@@ -716,17 +800,39 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 		size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
 		size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
-		/* TODO: Set up aux to pass information to the lazy_load_segment. */
-		void *aux = NULL;
-		if (!vm_alloc_page_with_initializer (VM_ANON, upage,
-					writable, lazy_load_segment, aux))
+		/* Segments are read by the same loader as mapped files, which
+		 * lets fault-around batch neighbouring pages of the executable.
+		 * Read-only pages stay backed by the file, so every process
+		 * running it can share one copy; writable ones become anonymous
+		 * once loaded.  Pages entirely in the BSS are plain anonymous
+		 * memory, which reads as the zero page until written. */
+		struct file_load_info *aux = NULL;
+		if (page_read_bytes > 0) {
+			aux = malloc (sizeof *aux);
+			if (aux == NULL)
+				return false;
+			aux->file = file;
+			aux->ofs = ofs;
+			aux->read_bytes = page_read_bytes;
+			aux->map_addr = NULL;
+		}
+		if (!vm_alloc_page_with_initializer (
+					aux != NULL && !writable ? VM_FILE : VM_ANON, upage,
+					writable, aux != NULL ? file_lazy_load : NULL, aux)) {
+			free (aux);
 			return false;
+		}
 
 		/* Advance. */
 		read_bytes -= page_read_bytes;
 		zero_bytes -= page_zero_bytes;
 		upage += PGSIZE;
+		ofs += PGSIZE;
 	}
+
+	/* The heap starts right after the highest segment. */
+	if ((void *) upage > spt->heap_start)
+		spt->heap_start = spt->brk = upage;
 	return true;
 }
 
@@ -740,6 +846,17 @@ setup_stack (struct intr_frame *if_) {
 	 * TODO: If success, set the rsp accordingly.
 	 * TODO: You should mark the page is stack. */
 	/* TODO: Your code goes here */
+	/* The stack may grow down over its whole reserve, which nothing else
+	 * may be mapped in. */
+	if (vma_create (&thread_current ()->spt,
+				(void *) (USER_STACK - STACK_LIMIT), (void *) USER_STACK, NULL,
+				0, VMA_STACK | VMA_WRITABLE) == NULL)
+		return false;
+	if (vm_alloc_page (VM_ANON | VM_STACK, stack_bottom, true)) {
+		success = vm_claim_page (stack_bottom);
+		if (success)
+			if_->rsp = USER_STACK;
+	}
 
 	return success;
 }
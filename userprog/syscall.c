@@ -1,12 +1,29 @@
 #include "userprog/syscall.h"
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
+#include "devices/input.h"
+#include "filesys/file.h"
+#include "filesys/filesys.h"
+#include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/loader.h"
+#include "threads/vaddr.h"
 #include "userprog/gdt.h"
+#include "userprog/process.h"
 #include "threads/flags.h"
 #include "intrinsic.h"
+#ifdef VM
+#include "vm/vm.h"
+#include "vm/fault.h"
+#endif
+
+/* Serializes file system operations other than reading and writing open
+ * files, which the inodes, the free map and the directories lock for
+ * themselves. */
+struct lock filesys_lock;
 
 /* 사용자 주소의 유효성을 검사하는 함수 */
 static void
@@ -24,6 +41,31 @@ check_buffer(const void *buffer, unsigned size) {
     }
 }
 
+/* Faults in every page of the user buffer of SIZE bytes at BUFFER, for
+ * writing if WRITE, so that a bad buffer kills the process before it
+ * takes an inode's lock rather than while it holds one. */
+static void
+touch_buffer (void *buffer, unsigned size, bool write) {
+	uint8_t *p = buffer, *end = p + size;
+
+	while (p < end) {
+		volatile uint8_t *b = p;
+		uint8_t v = *b;
+
+		if (write)
+			*b = v;
+		p = pg_round_down (p) + PGSIZE;
+	}
+}
+
+/* Returns the file open as FD in the running process, or NULL. */
+static struct file *
+fd_to_file (int fd) {
+	if (fd < 2 || fd >= FD_MAX)
+		return NULL;
+	return thread_current ()->fd_table[fd];
+}
+
 void syscall_entry (void);
 void syscall_handler (struct intr_frame *);
 
@@ -34,14 +76,193 @@ void exit(int status) {
 	thread_exit();
 }
 
+static int
+exec (const char *cmd_line) {
+	char *cmd_copy;
+
+	check_address (cmd_line);
+	cmd_copy = palloc_get_page (0);
+	if (cmd_copy == NULL)
+		exit (-1);
+	strlcpy (cmd_copy, cmd_line, PGSIZE);
+
+	/* Only returns on failure. */
+	if (process_exec (cmd_copy) < 0)
+		exit (-1);
+	NOT_REACHED ();
+}
+
+static bool
+create (const char *file, unsigned initial_size) {
+	bool success;
+
+	check_address (file);
+	lock_acquire (&filesys_lock);
+	success = filesys_create (file, initial_size);
+	lock_release (&filesys_lock);
+	return success;
+}
+
+static bool
+remove (const char *file) {
+	bool success;
+
+	check_address (file);
+	lock_acquire (&filesys_lock);
+	success = filesys_remove (file);
+	lock_release (&filesys_lock);
+	return success;
+}
+
+static int
+open (const char *file) {
+	struct file **fd_table = thread_current ()->fd_table;
+	struct file *f;
+	int fd;
+
+	check_address (file);
+	lock_acquire (&filesys_lock);
+	f = filesys_open (file);
+	lock_release (&filesys_lock);
+	if (f == NULL)
+		return -1;
+
+	for (fd = 2; fd < FD_MAX; fd++)
+		if (fd_table[fd] == NULL) {
+			fd_table[fd] = f;
+			return fd;
+		}
+
+	lock_acquire (&filesys_lock);
+	file_close (f);
+	lock_release (&filesys_lock);
+	return -1;
+}
+
+static int
+filesize (int fd) {
+	struct file *f = fd_to_file (fd);
+
+	return f != NULL ? file_length (f) : -1;
+}
+
+static int
+read (int fd, void *buffer, unsigned size) {
+	struct file *f;
+
+	check_buffer (buffer, size);
+	if (fd == 0) {
+		uint8_t *dst = buffer;
+		for (unsigned i = 0; i < size; i++)
+			dst[i] = input_getc ();
+		return size;
+	}
+
+	f = fd_to_file (fd);
+	if (f == NULL)
+		return -1;
+	touch_buffer (buffer, size, true);
+	return file_read (f, buffer, size);
+}
+
 int write(int fd, const void *buffer, unsigned size) {
+	struct file *f;
+
 	check_buffer(buffer, size); // 버퍼 유효성 검사
 	if (fd == 1) { // STDOUT
 		putbuf(buffer, size);
 		return size;
 	}
-	return -1;
+
+	f = fd_to_file (fd);
+	if (f == NULL)
+		return -1;
+	touch_buffer ((void *) buffer, size, false);
+	return file_write (f, buffer, size);
+}
+
+static void
+seek (int fd, unsigned position) {
+	struct file *f = fd_to_file (fd);
+
+	if (f == NULL)
+		return;
+	file_seek (f, position);
+}
+
+static unsigned
+tell (int fd) {
+	struct file *f = fd_to_file (fd);
+
+	return f != NULL ? file_tell (f) : 0;
+}
+
+static void
+close (int fd) {
+	struct file *f = fd_to_file (fd);
+
+	if (f == NULL)
+		return;
+	thread_current ()->fd_table[fd] = NULL;
+	lock_acquire (&filesys_lock);
+	file_close (f);
+	lock_release (&filesys_lock);
+}
+
+#ifdef VM
+static void *
+mmap (void *addr, size_t length, int writable, int fd, off_t offset) {
+	struct file *f;
+	void *mapping;
+
+	if (fd == MAP_ANONYMOUS)
+		return do_mmap_anon (addr, length, writable);
+	f = fd_to_file (fd);
+	if (f == NULL)
+		return NULL;
+	lock_acquire (&filesys_lock);
+	mapping = do_mmap (addr, length, writable, f, offset);
+	lock_release (&filesys_lock);
+	return mapping;
+}
+
+static void
+munmap (void *addr) {
+	lock_acquire (&filesys_lock);
+	do_munmap (addr);
+	lock_release (&filesys_lock);
+}
+
+/* Pages are brought in and written back by the pager, which does its file
+ * I/O without the file system lock. */
+static int
+madvise (void *addr, size_t length, int advice) {
+	return vm_advise (addr, length, advice) ? 0 : -1;
+}
+
+static void *
+sbrk (intptr_t increment) {
+	return do_sbrk (increment);
+}
+
+static int
+msync (void *addr, size_t length, int flags) {
+	return do_msync (addr, length, flags) ? 0 : -1;
+}
+
+static int
+fault_stats (int scope, struct fault_stats *stats) {
+	check_buffer (stats, sizeof *stats);
+	return fault_stats_read (scope, stats) ? 0 : -1;
+}
+
+static int
+cache_stats (struct cache_stats *stats) {
+	check_buffer (stats, sizeof *stats);
+	page_cache_stats_read (stats);
+	return 0;
 }
+#endif
 /* System call.
  *
  * Previously system call services was handled by the interrupt handler
@@ -66,6 +287,8 @@ syscall_init (void) {
 	 * mode stack. Therefore, we masked the FLAG_FL. */
 	write_msr(MSR_SYSCALL_MASK,
 			FLAG_IF | FLAG_TF | FLAG_DF | FLAG_IOPL | FLAG_AC | FLAG_NT);
+
+	lock_init (&filesys_lock);
 }
 
 /* The main system call interface */
@@ -74,14 +297,77 @@ syscall_handler (struct intr_frame *f) {
 	// 시스템 콜 번호는 rax 레지스터에 저장됩니다.
 	uint64_t syscall_no = f->R.rax;
 
+#ifdef VM
+	/* Page faults taken on user buffers grow the stack relative to this. */
+	thread_current ()->user_rsp = f->rsp;
+#endif
+
 	switch (syscall_no) {
 		case SYS_EXIT:
 			exit(f->R.rdi);
 			break;
+		case SYS_FORK:
+			check_address ((const char *) f->R.rdi);
+			f->R.rax = process_fork ((const char *) f->R.rdi, f);
+			break;
+		case SYS_EXEC:
+			f->R.rax = exec ((const char *) f->R.rdi);
+			break;
+		case SYS_WAIT:
+			f->R.rax = process_wait (f->R.rdi);
+			break;
+		case SYS_CREATE:
+			f->R.rax = create ((const char *) f->R.rdi, f->R.rsi);
+			break;
+		case SYS_REMOVE:
+			f->R.rax = remove ((const char *) f->R.rdi);
+			break;
+		case SYS_OPEN:
+			f->R.rax = open ((const char *) f->R.rdi);
+			break;
+		case SYS_FILESIZE:
+			f->R.rax = filesize (f->R.rdi);
+			break;
+		case SYS_READ:
+			f->R.rax = read (f->R.rdi, (void *) f->R.rsi, f->R.rdx);
+			break;
 		case SYS_WRITE:
 			check_address(f->R.rsi); // buffer 주소 유효성 검사
 			f->R.rax = write(f->R.rdi, (void *)f->R.rsi, f->R.rdx);
 			break;
+		case SYS_SEEK:
+			seek (f->R.rdi, f->R.rsi);
+			break;
+		case SYS_TELL:
+			f->R.rax = tell (f->R.rdi);
+			break;
+		case SYS_CLOSE:
+			close (f->R.rdi);
+			break;
+#ifdef VM
+		case SYS_MMAP:
+			f->R.rax = (uint64_t) mmap ((void *) f->R.rdi, f->R.rsi, f->R.rdx,
+					f->R.r10, f->R.r8);
+			break;
+		case SYS_MUNMAP:
+			munmap ((void *) f->R.rdi);
+			break;
+		case SYS_MADVISE:
+			f->R.rax = madvise ((void *) f->R.rdi, f->R.rsi, f->R.rdx);
+			break;
+		case SYS_SBRK:
+			f->R.rax = (uint64_t) sbrk ((intptr_t) f->R.rdi);
+			break;
+		case SYS_MSYNC:
+			f->R.rax = msync ((void *) f->R.rdi, f->R.rsi, f->R.rdx);
+			break;
+		case SYS_FAULT_STATS:
+			f->R.rax = fault_stats (f->R.rdi, (struct fault_stats *) f->R.rsi);
+			break;
+		case SYS_CACHE_STATS:
+			f->R.rax = cache_stats ((struct cache_stats *) f->R.rdi);
+			break;
+#endif
 		case SYS_HALT:
 			power_off();
 			break;
@@ -1,7 +1,18 @@
 /* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page). */
 
+#include <bitmap.h>
+#include <round.h>
+#include <string.h>
 #include "vm/vm.h"
+#include "vm/zswap.h"
 #include "devices/disk.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Number of swap disk sectors that hold one page. */
+#define SECTORS_PER_PAGE (PGSIZE / DISK_SECTOR_SIZE)
 
 /* DO NOT MODIFY BELOW LINE */
 static struct disk *swap_disk;
@@ -17,11 +28,21 @@ static const struct page_operations anon_ops = {
 	.type = VM_ANON,
 };
 
+/* Swap slots in use, one bit per page-sized slot on the swap disk. */
+static struct bitmap *swap_table;
+static struct lock swap_lock;
+
 /* Initialize the data for anonymous pages */
 void
 vm_anon_init (void) {
 	/* TODO: Set up the swap_disk. */
-	swap_disk = NULL;
+	swap_disk = disk_get (1, 1);
+	lock_init (&swap_lock);
+	swap_table = bitmap_create (swap_disk != NULL
+			? disk_size (swap_disk) / SECTORS_PER_PAGE : 0);
+	if (swap_table == NULL)
+		PANIC ("swap table creation failed");
+	zswap_init ();
 }
 
 /* Initialize the file mapping */
@@ -31,22 +52,203 @@ anon_initializer (struct page *page, enum vm_type type, void *kva) {
 	page->operations = &anon_ops;
 
 	struct anon_page *anon_page = &page->anon;
+	anon_page->swap_slot = SWAP_SLOT_NONE;
+	anon_page->zentry = NULL;
+	anon_page->type = type;
+	memset (kva, 0, PGSIZE);
+	return true;
 }
 
 /* Swap in the page by read contents from the swap disk. */
 static bool
 anon_swap_in (struct page *page, void *kva) {
 	struct anon_page *anon_page = &page->anon;
+	size_t i;
+
+	if (zswap_load (page, kva))
+		return true;
+	if (anon_page->swap_slot == SWAP_SLOT_NONE)
+		return false;
+
+	for (i = 0; i < SECTORS_PER_PAGE; i++)
+		disk_read (swap_disk, anon_page->swap_slot * SECTORS_PER_PAGE + i,
+				(uint8_t *) kva + i * DISK_SECTOR_SIZE);
+
+	lock_acquire (&swap_lock);
+	bitmap_reset (swap_table, anon_page->swap_slot);
+	lock_release (&swap_lock);
+	anon_page->swap_slot = SWAP_SLOT_NONE;
+	return true;
+}
+
+/* Writes the page at KVA to a free swap slot and returns the slot, or
+ * SWAP_SLOT_NONE if the swap disk is full. */
+size_t
+anon_swap_write (const void *kva) {
+	size_t slot, i;
+
+	lock_acquire (&swap_lock);
+	slot = bitmap_scan_and_flip (swap_table, 0, 1, false);
+	lock_release (&swap_lock);
+	if (slot == BITMAP_ERROR)
+		return SWAP_SLOT_NONE;
+
+	for (i = 0; i < SECTORS_PER_PAGE; i++)
+		disk_write (swap_disk, slot * SECTORS_PER_PAGE + i,
+				(const uint8_t *) kva + i * DISK_SECTOR_SIZE);
+	return slot;
 }
 
 /* Swap out the page by writing contents to the swap disk. */
 static bool
 anon_swap_out (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
+
+	/* Unmap first, so the owner faults instead of writing to a frame whose
+	 * contents are already on their way out. */
+	pml4_clear_page (page->pml4, page->va);
+
+	/* The compressed cache, if enabled, takes the page unless it is full
+	 * of pages that cannot be spilled or the page does not compress. */
+	if (!zswap_store (page, page->frame->kva)) {
+		anon_page->swap_slot = anon_swap_write (page->frame->kva);
+		if (anon_page->swap_slot == SWAP_SLOT_NONE)
+			return false;
+	}
+	return true;
 }
 
 /* Destroy the anonymous page. PAGE will be freed by the caller. */
 static void
 anon_destroy (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
+
+	/* First, so that a write-out in progress has its slot or entry by
+	 * the time they are freed. */
+	vm_release_frame (page);
+	zswap_drop (page);
+	if (anon_page->swap_slot != SWAP_SLOT_NONE) {
+		lock_acquire (&swap_lock);
+		bitmap_reset (swap_table, anon_page->swap_slot);
+		lock_release (&swap_lock);
+		anon_page->swap_slot = SWAP_SLOT_NONE;
+	}
+}
+
+/* Removes whichever of the PAGE_CNT pages from ADDR are in use. */
+static void
+free_anon_range (struct supplemental_page_table *spt, uintptr_t addr,
+		size_t page_cnt) {
+	size_t i;
+
+	for (i = 0; i < page_cnt; i++) {
+		struct page *page = spt_find_page (spt, (void *) (addr + i * PGSIZE));
+		if (page != NULL)
+			spt_remove_page (spt, page);
+	}
+}
+
+/* Sets up PAGE_CNT anonymous pages from ADDR, which take no memory until
+ * they are first touched.  On failure, the pages already set up are
+ * removed again and false is returned. */
+static bool
+alloc_anon_range (struct supplemental_page_table *spt, uintptr_t addr,
+		size_t page_cnt, bool writable) {
+	size_t i;
+
+	for (i = 0; i < page_cnt; i++)
+		if (!vm_alloc_page (VM_ANON, (void *) (addr + i * PGSIZE), writable)) {
+			free_anon_range (spt, addr, i);
+			return false;
+		}
+	return true;
+}
+
+/* Maps LENGTH bytes of zero-filled memory at ADDR in the running process.
+ * If ADDR is NULL, the mapping goes in the highest free range between the
+ * heap and the stack's reserve.  Returns the address of the mapping, or
+ * NULL on failure. */
+void *
+do_mmap_anon (void *addr, size_t length, bool writable) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct vma *vma;
+	size_t page_cnt;
+
+	if (length == 0 || length > USER_STACK || pg_ofs (addr) != 0)
+		return NULL;
+	page_cnt = DIV_ROUND_UP (length, PGSIZE);
+
+	if (addr == NULL) {
+		void *floor = spt->brk != NULL ? pg_round_up (spt->brk)
+			: (void *) PGSIZE;
+
+		addr = vma_find_free (spt, page_cnt * PGSIZE, floor,
+				(void *) (USER_STACK - STACK_LIMIT));
+		if (addr == NULL)
+			return NULL;
+	} else if ((uintptr_t) addr + length < (uintptr_t) addr
+			|| !is_user_vaddr ((uint8_t *) addr + length - 1))
+		return NULL;
+
+	vma = vma_create (spt, addr, (uint8_t *) addr + page_cnt * PGSIZE, NULL,
+			0, VMA_MAPPED | (writable ? VMA_WRITABLE : 0));
+	if (vma == NULL)
+		return NULL;
+	if (!alloc_anon_range (spt, (uintptr_t) addr, page_cnt, writable)) {
+		vma_destroy (spt, vma);
+		return NULL;
+	}
+	return addr;
+}
+
+/* Moves the end of the running process's heap by INCREMENT bytes and
+ * returns the previous end, or (void *) -1 on failure.  New heap pages are
+ * anonymous memory that takes no frame until touched; pages the heap no
+ * longer reaches are freed. */
+void *
+do_sbrk (intptr_t increment) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	uintptr_t old_brk = (uintptr_t) spt->brk;
+	uintptr_t new_brk = old_brk + increment;
+	uintptr_t old_end = ROUND_UP (old_brk, PGSIZE);
+	uintptr_t new_end;
+
+	if (spt->heap_start == NULL
+			|| (increment > 0 && new_brk < old_brk)
+			|| (increment < 0 && new_brk > old_brk)
+			|| new_brk < (uintptr_t) spt->heap_start
+			|| new_brk > USER_STACK - STACK_LIMIT)
+		return (void *) -1;
+
+	new_end = ROUND_UP (new_brk, PGSIZE);
+	if (new_end > old_end) {
+		size_t page_cnt = (new_end - old_end) / PGSIZE;
+
+		/* The heap's area must be able to grow before any page of it is
+		 * set up. */
+		if (spt->heap == NULL) {
+			spt->heap = vma_create (spt, (void *) old_end, (void *) new_end,
+					NULL, 0, VMA_HEAP | VMA_WRITABLE);
+			if (spt->heap == NULL)
+				return (void *) -1;
+		} else if (!vma_resize (spt, spt->heap, (void *) new_end))
+			return (void *) -1;
+
+		if (!alloc_anon_range (spt, old_end, page_cnt, true)) {
+			if (spt->heap->start == (void *) old_end)
+				vma_destroy (spt, spt->heap);
+			else
+				vma_resize (spt, spt->heap, (void *) old_end);
+			return (void *) -1;
+		}
+	} else if (new_end < old_end) {
+		free_anon_range (spt, new_end, (old_end - new_end) / PGSIZE);
+		if (spt->heap->start == (void *) new_end)
+			vma_destroy (spt, spt->heap);
+		else
+			vma_resize (spt, spt->heap, (void *) new_end);
+	}
+
+	spt->brk = (void *) new_brk;
+	return (void *) old_brk;
 }
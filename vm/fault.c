@@ -0,0 +1,88 @@
+/* fault.c: Page fault classification and latency statistics.
+ *
+ * Every fault the pager sees is counted in one class, for the process that
+ * took it and globally, and the cycles it took to handle go into a log2
+ * histogram of that class.  The totals are printed at shutdown and can be
+ * read by a process with the fault_stats () system call, which shows
+ * which kinds of faults dominate a workload and what each kind costs. */
+
+#include "vm/fault.h"
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#include "vm/vm.h"
+
+struct fault_stats vm_fault_stats;
+
+/* Names of the classes, as printed. */
+static const char *class_names[FAULT_CLASS_CNT] = {
+	"lazy-load", "zero-fill", "stack-growth", "COW", "swap-in", "file-in",
+	"invalid",
+};
+
+/* Records a fault of class CLS, one of the FAULT_* values, that took
+ * CYCLES to handle.  SPT is the process that took it, or NULL if it was
+ * no process. */
+void
+fault_record (struct supplemental_page_table *spt, int cls,
+		uint64_t cycles) {
+	enum intr_level old_level;
+	int bucket = 0;
+
+	ASSERT (cls >= 0 && cls < FAULT_CLASS_CNT);
+
+	while (cycles > 1 && bucket < FAULT_HIST_BUCKETS - 1) {
+		cycles >>= 1;
+		bucket++;
+	}
+
+	/* Faults are taken by every thread; keep the counters consistent. */
+	old_level = intr_disable ();
+	vm_fault_stats.cnt[cls]++;
+	vm_fault_stats.hist[cls][bucket]++;
+	if (spt != NULL)
+		spt->faults[cls]++;
+	intr_set_level (old_level);
+}
+
+/* Copies the fault statistics of SCOPE, FAULT_STATS_PROCESS or
+ * FAULT_STATS_GLOBAL, into STATS, which may be in user memory.  Returns
+ * false if SCOPE is invalid. */
+bool
+fault_stats_read (int scope, struct fault_stats *stats) {
+	switch (scope) {
+		case FAULT_STATS_PROCESS:
+			memset (stats, 0, sizeof *stats);
+			memcpy (stats->cnt, thread_current ()->spt.faults,
+					sizeof stats->cnt);
+			return true;
+		case FAULT_STATS_GLOBAL:
+			memcpy (stats, &vm_fault_stats, sizeof *stats);
+			return true;
+		default:
+			return false;
+	}
+}
+
+/* Prints page fault statistics. */
+void
+fault_print_stats (void) {
+	int cls, i;
+
+	printf ("Page faults:");
+	for (cls = 0; cls < FAULT_CLASS_CNT; cls++)
+		printf ("%s %llu %s", cls ? "," : "", vm_fault_stats.cnt[cls],
+				class_names[cls]);
+	printf ("\n");
+
+	for (cls = 0; cls < FAULT_CLASS_CNT; cls++) {
+		if (vm_fault_stats.cnt[cls] == 0)
+			continue;
+		printf ("  %s cycles, log2:", class_names[cls]);
+		for (i = 0; i < FAULT_HIST_BUCKETS; i++)
+			if (vm_fault_stats.hist[cls][i] != 0)
+				printf (" %d:%llu", i, vm_fault_stats.hist[cls][i]);
+		printf ("\n");
+	}
+}
@@ -1,6 +1,12 @@
 /* file.c: Implementation of memory backed file object (mmaped object). */
 
+#include <round.h>
+#include <string.h>
+#include <syscall-nr.h>
 #include "vm/vm.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/vaddr.h"
 
 static bool file_backed_swap_in (struct page *page, void *kva);
 static bool file_backed_swap_out (struct page *page);
@@ -21,38 +27,288 @@ vm_file_init (void) {
 
 /* Initialize the file backed page */
 bool
-file_backed_initializer (struct page *page, enum vm_type type, void *kva) {
+file_backed_initializer (struct page *page, enum vm_type type UNUSED,
+		void *kva UNUSED) {
 	/* Set up the handler */
 	page->operations = &file_ops;
 
 	struct file_page *file_page = &page->file;
+	memset (file_page, 0, sizeof *file_page);
+	return true;
+}
+
+/* Reads READ_BYTES bytes at OFS of FILE into the page at KVA and zeroes the
+ * rest of it.
+ *
+ * The pager does file I/O without the file system lock: inode_read_at ()
+ * and inode_write_at () share no state besides the page cache, which has a
+ * lock of its own, and a system call may fault on its user buffer while
+ * holding the lock. */
+static bool
+read_page (struct file *file, off_t ofs, size_t read_bytes, void *kva) {
+	off_t bytes_read = file_read_at (file, kva, read_bytes, ofs);
+
+	memset ((uint8_t *) kva + read_bytes, 0, PGSIZE - read_bytes);
+	return bytes_read == (off_t) read_bytes;
+}
+
+/* Records in the file-backed PAGE where it comes from. */
+static void
+set_file_page (struct page *page, const struct file_load_info *info) {
+	page->file = (struct file_page) {
+		.file = info->file,
+		.ofs = info->ofs,
+		.read_bytes = info->read_bytes,
+		.map_addr = info->map_addr,
+	};
+}
+
+/* Lazy loader for pages whose contents come from a file.  AUX is a
+ * `struct file_load_info', which is freed here; pages that stay backed by
+ * the file keep what they need in their `struct file_page'. */
+bool
+file_lazy_load (struct page *page, void *aux) {
+	struct file_load_info *info = aux;
+	bool success;
+
+	success = read_page (info->file, info->ofs, info->read_bytes,
+			page->frame->kva);
+	if (page->operations->type == VM_FILE)
+		set_file_page (page, info);
+	free (info);
+	return success;
+}
+
+/* If PAGE is not resident and can be read straight from a file, stores the
+ * file's inode and the page's offset in it into *INODE and *OFS and returns
+ * true.  Used by fault-around to find neighbours worth mapping early. */
+bool
+file_page_source (struct page *page, struct inode **inode, off_t *ofs) {
+	if (page->frame != NULL)
+		return false;
+
+	if (VM_TYPE (page->operations->type) == VM_UNINIT) {
+		struct file_load_info *info = page->uninit.aux;
+
+		if (page->uninit.init != file_lazy_load)
+			return false;
+		*inode = file_get_inode (info->file);
+		*ofs = info->ofs;
+		return true;
+	}
+	if (page->operations->type == VM_FILE) {
+		*inode = file_get_inode (page->file.file);
+		*ofs = page->file.ofs;
+		return true;
+	}
+	return false;
+}
+
+/* Like file_page_source (), but only for file-backed pages that map their
+ * part of the file as it is, so that they can map the file's frame in the
+ * page cache: mapped pages, and executable pages whose whole page comes
+ * from the file or that hold all of the file from OFS on.  A mapping's
+ * last page goes through the cache even where it reaches past the end of
+ * the file, since the file may grow under it; the cache zeroes what lies
+ * past the end.  Pages of executable text that end in zeros where the
+ * file goes on get frames of their own. */
+bool
+file_cache_source (struct page *page, struct inode **inode, off_t *ofs) {
+	struct file *file;
+	size_t read_bytes;
+	void *map_addr;
+
+	if (page_get_type (page) != VM_FILE
+			|| !file_page_source (page, inode, ofs))
+		return false;
+
+	if (VM_TYPE (page->operations->type) == VM_UNINIT) {
+		struct file_load_info *info = page->uninit.aux;
+
+		file = info->file;
+		read_bytes = info->read_bytes;
+		map_addr = info->map_addr;
+	} else {
+		file = page->file.file;
+		read_bytes = page->file.read_bytes;
+		map_addr = page->file.map_addr;
+	}
+	return map_addr != NULL || read_bytes == PGSIZE
+		|| *ofs + (off_t) read_bytes >= file_length (file);
+}
+
+/* Turns PAGE, a file-backed page still waiting for its first load, into a
+ * file-backed page without reading anything: its contents are already
+ * resident in the page cache. */
+void
+file_cache_attach (struct page *page) {
+	struct file_load_info *info;
+
+	if (VM_TYPE (page->operations->type) != VM_UNINIT)
+		return;
+
+	info = page->uninit.aux;
+	file_backed_initializer (page, VM_FILE, NULL);
+	set_file_page (page, info);
+	free (info);
+}
+
+/* Gives up the frame of PAGE, a resident file-backed page.  What the user
+ * wrote to it stays in the page cache until it is written back; the next
+ * access maps or reads it from there again. */
+void
+file_page_drop (struct page *page) {
+	if (page->frame == NULL)
+		return;
+	vm_release_frame (page);
+}
+
+/* Returns a new load info for setting up PAGE, a file-backed page or one
+ * still waiting for file_lazy_load (), in a child of its process.  The
+ * child's mapped pages borrow the file of its copy of their area; its
+ * executable pages read from its own running_file.  Returns NULL on
+ * failure. */
+struct file_load_info *
+file_load_info_copy (struct page *page) {
+	struct file_load_info *info = malloc (sizeof *info);
+
+	if (info == NULL)
+		return NULL;
+	if (VM_TYPE (page->operations->type) == VM_UNINIT)
+		*info = *(struct file_load_info *) page->uninit.aux;
+	else
+		*info = (struct file_load_info) {
+			.file = page->file.file,
+			.ofs = page->file.ofs,
+			.read_bytes = page->file.read_bytes,
+			.map_addr = page->file.map_addr,
+		};
+
+	if (info->map_addr != NULL)
+		info->file = vma_find (&thread_current ()->spt, page->va)->file;
+	else
+		info->file = thread_current ()->running_file;
+	return info;
 }
 
 /* Swap in the page by read contents from the file. */
 static bool
 file_backed_swap_in (struct page *page, void *kva) {
-	struct file_page *file_page UNUSED = &page->file;
+	struct file_page *file_page = &page->file;
+
+	return read_page (file_page->file, file_page->ofs, file_page->read_bytes,
+			kva);
 }
 
-/* Swap out the page by writeback contents to the file. */
+/* Swap out the page by writeback contents to the file.  Only pages with a
+ * frame of their own get here, and those are read-only copies: a page that
+ * can be written maps a page cache frame, evicted by the cache. */
 static bool
 file_backed_swap_out (struct page *page) {
-	struct file_page *file_page UNUSED = &page->file;
+	pml4_clear_page (page->pml4, page->va);
+	return true;
 }
 
-/* Destory the file backed page. PAGE will be freed by the caller. */
+/* Destory the file backed page. PAGE will be freed by the caller.  Its
+ * file belongs to its area or to the process, which close it. */
 static void
 file_backed_destroy (struct page *page) {
-	struct file_page *file_page UNUSED = &page->file;
+	vm_release_frame (page);
 }
 
 /* Do the mmap */
 void *
 do_mmap (void *addr, size_t length, int writable,
 		struct file *file, off_t offset) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct vma *vma;
+	size_t page_cnt, i;
+	off_t file_len;
+
+	if (addr == NULL || pg_ofs (addr) != 0 || length == 0
+			|| offset < 0 || pg_ofs (offset) != 0)
+		return NULL;
+	if ((uintptr_t) addr + length < (uintptr_t) addr
+			|| !is_user_vaddr ((uint8_t *) addr + length - 1))
+		return NULL;
+
+	file_len = file_length (file);
+	if (file_len == 0)
+		return NULL;
+
+	/* The whole range must be free before anything is mapped: no
+	 * segment, stack, heap or other mapping may overlap it. */
+	page_cnt = DIV_ROUND_UP (length, PGSIZE);
+	vma = vma_create (spt, addr, (uint8_t *) addr + page_cnt * PGSIZE, file,
+			offset, VMA_MAPPED | (writable ? VMA_WRITABLE : 0));
+	if (vma == NULL)
+		return NULL;
+
+	for (i = 0; i < page_cnt; i++) {
+		void *upage = (uint8_t *) addr + i * PGSIZE;
+		off_t ofs = offset + i * PGSIZE;
+		struct file_load_info *info = malloc (sizeof *info);
+
+		if (info == NULL)
+			goto fail;
+		info->file = vma->file;
+		info->ofs = ofs;
+		info->read_bytes = ofs < file_len
+			? (file_len - ofs < PGSIZE ? file_len - ofs : PGSIZE) : 0;
+		info->map_addr = addr;
+		if (!vm_alloc_page_with_initializer (VM_FILE, upage, writable,
+					file_lazy_load, info)) {
+			free (info);
+			goto fail;
+		}
+	}
+	return addr;
+
+fail:
+	vma_destroy (spt, vma);
+	return NULL;
+}
+
+/* Writes back the parts of files mapped by the running process from ADDR,
+ * which must be page-aligned, up to ADDR + LENGTH.  With MS_SYNC they are
+ * on disk when this returns; with MS_ASYNC they are left to the writeback
+ * daemon, which writes every dirty page in bounded time anyway.  Areas not
+ * mapped from a file are skipped.  Returns false if the arguments are
+ * invalid or part of the range is not mapped at all. */
+bool
+do_msync (void *addr, size_t length, int flags) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	uint8_t *va = addr, *end = va + length;
+
+	if (pg_ofs (addr) != 0 || (flags != MS_SYNC && flags != MS_ASYNC))
+		return false;
+	if (end < va || (length != 0 && !is_user_vaddr (end - 1)))
+		return false;
+
+	while (va < end) {
+		struct vma *vma = vma_find (spt, va);
+		uint8_t *stop;
+
+		if (vma == NULL)
+			return false;
+		stop = end < (uint8_t *) vma->end ? end : (uint8_t *) vma->end;
+		if (flags == MS_SYNC && (vma->flags & VMA_MAPPED) && vma->file != NULL)
+			page_cache_sync (file_get_inode (vma->file),
+					vma->ofs + (va - (uint8_t *) vma->start),
+					vma->ofs + (stop - (uint8_t *) vma->start));
+		va = stop;
+	}
+	return true;
 }
 
-/* Do the munmap */
+/* Do the munmap.  Removes the mapping, file-backed or anonymous, that
+ * starts at ADDR.  What was changed in a file is written back by the page
+ * cache. */
 void
 do_munmap (void *addr) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct vma *vma = vma_find (spt, addr);
+
+	if (vma != NULL && vma->start == addr && (vma->flags & VMA_MAPPED))
+		vma_destroy (spt, vma);
 }
@@ -0,0 +1,215 @@
+/* ksm.c: Background merging of identical anonymous pages.
+ *
+ * ksmd, a low-priority kernel thread, walks the frame table a few frames
+ * at a time.  A frame whose contents hash the same on two visits in a row
+ * is entered into the stable table, keyed by that hash.  When another
+ * frame with the same hash turns up, both are write-protected, compared
+ * byte by byte and, if identical, the pages of the newcomer are remapped
+ * onto the stable frame and the newcomer is freed.  A write to a merged
+ * page faults, and vm_handle_wp () gives it a private copy again.  That
+ * includes the kernel's own writes into user memory, such as read ()
+ * copying into a merged page: start.S sets CR0.WP, so they do not slip
+ * through the read-only mapping. */
+
+#include "vm/ksm.h"
+#include <hash.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/vm.h"
+
+/* Frames scanned per wake-up, and timer ticks slept in between. */
+#define KSM_BATCH 32
+#define KSM_SLEEP 10
+
+bool ksm_enabled;
+struct ksm_stats ksm_stats;
+
+/* Frames whose contents did not change between two scans, by hash.
+ * Protected by frame_lock, like the frames themselves. */
+static struct hash stable_table;
+
+/* Next frame to scan, or NULL to start over at the head of the frame
+ * table. */
+static struct frame *ksm_cursor;
+
+static thread_func ksmd;
+static hash_hash_func stable_hash;
+static hash_less_func stable_less;
+
+/* Initializes the page merger and starts ksmd if it is enabled. */
+void
+ksm_init (void) {
+	hash_init (&stable_table, stable_hash, stable_less, NULL);
+	ksm_cursor = NULL;
+	if (ksm_enabled)
+		thread_create ("ksmd", PRI_MIN, ksmd, NULL);
+}
+
+/* Drops every reference the merger holds to FRAME, which is about to
+ * leave the frame table.  Must be called with frame_lock held. */
+void
+ksm_forget_frame (struct frame *frame) {
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	if (frame->ksm_listed) {
+		hash_delete (&stable_table, &frame->ksm_elem);
+		frame->ksm_listed = false;
+	}
+	frame->checksum = 0;
+	if (ksm_cursor == frame) {
+		struct list_elem *next = list_next (&frame->elem);
+		ksm_cursor = next != list_end (&frame_table)
+			? list_entry (next, struct frame, elem) : NULL;
+	}
+}
+
+/* Prints same-page merging statistics. */
+void
+ksm_print_stats (void) {
+	if (ksm_enabled)
+		printf ("KSM: %llu pages scanned, %llu merged, %llu broken on write\n",
+				ksm_stats.scanned, ksm_stats.merged, ksm_stats.broken);
+}
+
+/* Returns true if FRAME holds only anonymous pages. */
+static bool
+is_mergeable (struct frame *frame) {
+	struct list_elem *e;
+
+	if (frame->cache != NULL || list_empty (&frame->pages))
+		return false;
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e))
+		if (page_get_type (list_entry (e, struct page, frame_elem)) != VM_ANON)
+			return false;
+	return true;
+}
+
+/* Makes every page mapping FRAME read-only. */
+static void
+write_protect (struct frame *frame) {
+	struct list_elem *e;
+
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, frame_elem);
+		pml4_set_writable (page->pml4, page->va, false);
+	}
+}
+
+/* Remaps the pages of FRAME onto STABLE and frees FRAME, if the two hold
+ * the same bytes.  Both are write-protected first, so neither can change
+ * between the comparison and the remapping.  Returns true if merged. */
+static bool
+merge (struct frame *stable, struct frame *frame) {
+	write_protect (stable);
+	write_protect (frame);
+	if (memcmp (stable->kva, frame->kva, PGSIZE))
+		return false;
+
+	while (!list_empty (&frame->pages)) {
+		struct page *page = list_entry (list_pop_front (&frame->pages),
+				struct page, frame_elem);
+
+		pml4_clear_page (page->pml4, page->va);
+		pml4_set_page (page->pml4, page->va, stable->kva, false);
+		page->frame = stable;
+		list_push_back (&stable->pages, &page->frame_elem);
+		ksm_stats.merged++;
+	}
+	frame->page = NULL;
+	vm_free_frame (frame);
+	return true;
+}
+
+/* Hashes FRAME and merges it with a stable frame holding the same bytes,
+ * if there is one.  Must be called with frame_lock held. */
+static void
+scan_frame (struct frame *frame) {
+	struct hash_elem *e;
+	uint64_t checksum;
+
+	if (!is_mergeable (frame))
+		return;
+	ksm_stats.scanned++;
+	checksum = hash_bytes (frame->kva, PGSIZE);
+
+	if (frame->ksm_listed) {
+		if (checksum == frame->checksum)
+			return;
+		hash_delete (&stable_table, &frame->ksm_elem);
+		frame->ksm_listed = false;
+	}
+
+	/* A page that changed since the last visit is likely to change again
+	 * soon; merging it would only cost a copy on the next write. */
+	if (checksum != frame->checksum) {
+		frame->checksum = checksum;
+		return;
+	}
+
+	e = hash_insert (&stable_table, &frame->ksm_elem);
+	if (e == NULL)
+		frame->ksm_listed = true;
+	else if (!merge (hash_entry (e, struct frame, ksm_elem), frame)) {
+		/* The stable frame has been written since it was listed. */
+		struct frame *stale = hash_entry (hash_replace (&stable_table,
+					&frame->ksm_elem), struct frame, ksm_elem);
+		stale->ksm_listed = false;
+		frame->ksm_listed = true;
+	}
+}
+
+/* Scans up to KSM_BATCH frames, starting where the last call stopped.
+ * The lock is dropped between frames so faults are not held up. */
+static void
+scan_batch (void) {
+	int i;
+
+	for (i = 0; i < KSM_BATCH; i++) {
+		struct frame *frame;
+		struct list_elem *next;
+
+		lock_acquire (&frame_lock);
+		if (list_empty (&frame_table)) {
+			lock_release (&frame_lock);
+			break;
+		}
+		frame = ksm_cursor != NULL ? ksm_cursor
+			: list_entry (list_begin (&frame_table), struct frame, elem);
+		next = list_next (&frame->elem);
+		ksm_cursor = next != list_end (&frame_table)
+			? list_entry (next, struct frame, elem) : NULL;
+		scan_frame (frame);
+		lock_release (&frame_lock);
+	}
+}
+
+/* Page merging thread. */
+static void
+ksmd (void *aux UNUSED) {
+	for (;;) {
+		scan_batch ();
+		timer_sleep (KSM_SLEEP);
+	}
+}
+
+/* Returns a hash value for the stable frame that E belongs to. */
+static uint64_t
+stable_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct frame *frame = hash_entry (e, struct frame, ksm_elem);
+	return frame->checksum;
+}
+
+/* Orders stable frames by contents hash. */
+static bool
+stable_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return hash_entry (a, struct frame, ksm_elem)->checksum
+		< hash_entry (b, struct frame, ksm_elem)->checksum;
+}
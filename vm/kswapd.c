@@ -0,0 +1,92 @@
+/* kswapd.c: Background page-out daemon.
+ *
+ * Evicting a page in the faulting thread makes that fault wait for a swap
+ * or file write.  kswapd keeps a reserve of free user frames instead: it is
+ * woken when the number of free frames drops below the low watermark and
+ * evicts pages, a batch at a time, until it is back above the high
+ * watermark.  Faults then usually find a free frame, and only fall back to
+ * evicting a page themselves when the daemon cannot keep up. */
+
+#include "vm/kswapd.h"
+#include <stdio.h>
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "vm/vm.h"
+
+/* Most frames picked for eviction in one batch. */
+#define KSWAPD_BATCH 8
+
+/* Default low watermark: a fraction of the user pool, but no less than a
+ * few frames. */
+#define KSWAPD_LOW_SHIFT 6
+#define KSWAPD_LOW_MIN 8
+
+size_t kswapd_low = SIZE_MAX;
+static size_t kswapd_high;
+struct reclaim_stats reclaim_stats;
+
+/* Upped to wake the daemon. */
+static struct semaphore kswapd_sema;
+
+/* Set from the wake-up until the daemon is done, so that every allocation
+ * in between does not up the semaphore again. */
+static bool kswapd_busy;
+
+static thread_func kswapd;
+
+/* Sets the watermarks and starts the page-out daemon, unless it was
+ * disabled. */
+void
+kswapd_init (void) {
+	sema_init (&kswapd_sema, 0);
+	if (kswapd_low == SIZE_MAX) {
+		kswapd_low = palloc_user_pages () >> KSWAPD_LOW_SHIFT;
+		if (kswapd_low < KSWAPD_LOW_MIN)
+			kswapd_low = KSWAPD_LOW_MIN;
+	}
+	kswapd_high = kswapd_low * 2;
+	if (kswapd_low != 0)
+		thread_create ("kswapd", PRI_DEFAULT, kswapd, NULL);
+}
+
+/* Wakes the page-out daemon if free user frames have dropped below the
+ * low watermark. */
+void
+kswapd_check (void) {
+	if (kswapd_low == 0 || kswapd_busy
+			|| palloc_user_free_pages () >= kswapd_low)
+		return;
+	kswapd_busy = true;
+	reclaim_stats.wakeups++;
+	sema_up (&kswapd_sema);
+}
+
+/* Prints page reclaim statistics. */
+void
+kswapd_print_stats (void) {
+	printf ("Reclaim: %llu pages by kswapd in %llu wakeups, %llu direct\n",
+			reclaim_stats.background, reclaim_stats.wakeups,
+			reclaim_stats.direct);
+}
+
+/* The page-out daemon.  Refills the free frames up to the high watermark
+ * each time it is woken, or until there is nothing left to evict. */
+static void
+kswapd (void *aux UNUSED) {
+	for (;;) {
+		size_t free_cnt;
+
+		sema_down (&kswapd_sema);
+		while ((free_cnt = palloc_user_free_pages ()) < kswapd_high) {
+			size_t want = kswapd_high - free_cnt;
+			size_t freed = vm_reclaim (want < KSWAPD_BATCH
+					? want : KSWAPD_BATCH);
+
+			if (freed == 0)
+				break;
+			reclaim_stats.background += freed;
+		}
+		kswapd_busy = false;
+	}
+}
@@ -0,0 +1,182 @@
+/* reaper.c: Deferred teardown of the address spaces of exited processes.
+ *
+ * Freeing every page, swap slot and page table of a large process takes
+ * time, and a parent waiting for the process to exit would wait for all of
+ * it.  An exiting process hands its address space to the reaper instead:
+ * its pages, page table and executable are detached from the thread and
+ * queued, the parent is woken right away, and a background thread frees
+ * them.  A thread that runs out of free frames before the reaper gets to
+ * a queued address space takes back its frames itself rather than evict
+ * pages that are still in use, and leaves the rest to the reaper. */
+
+#include "vm/reaper.h"
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "vm/vm.h"
+
+/* The address space of an exited process, waiting to be torn down. */
+struct corpse {
+	struct list_elem elem;      /* Element in `corpses'. */
+	struct supplemental_page_table spt; /* Its pages. */
+	uint64_t *pml4;             /* Its page table. */
+	struct file *running_file;  /* Executable its text pages read from. */
+};
+
+/* Address spaces waiting to be torn down, oldest first. */
+static struct list corpses;
+static struct lock corpses_lock;
+
+/* Upped once for each address space queued. */
+static struct semaphore reaper_sema;
+
+struct reaper_stats reaper_stats;
+
+static thread_func reaper;
+
+/* Starts the reaper. */
+void
+reaper_init (void) {
+	list_init (&corpses);
+	lock_init (&corpses_lock);
+	sema_init (&reaper_sema, 0);
+	thread_create ("reaper", PRI_DEFAULT, reaper, NULL);
+}
+
+/* Detaches the address space of T, the running process, which is exiting,
+ * and queues it for the reaper.  T is left with an empty supplemental
+ * page table and no page table.  Returns false, leaving T as it was, if
+ * memory is short. */
+bool
+reaper_defer (struct thread *t) {
+	struct corpse *corpse;
+	struct hash_iterator i;
+
+	ASSERT (t == thread_current ());
+	ASSERT (t->pml4 != NULL);
+
+	corpse = malloc (sizeof *corpse);
+	if (corpse == NULL)
+		return false;
+
+	/* Leave the page table before it is handed over, as
+	 * process_cleanup () does before destroying it. */
+	corpse->pml4 = t->pml4;
+	t->pml4 = NULL;
+	pml4_activate (NULL);
+
+	/* The evictor and the merger reach the pages through their frames,
+	 * and follow each page to its table. */
+	lock_acquire (&frame_lock);
+	memcpy (&corpse->spt, &t->spt, sizeof t->spt);
+	hash_first (&i, &corpse->spt.pages);
+	while (hash_next (&i))
+		hash_entry (hash_cur (&i), struct page, spt_elem)->spt = &corpse->spt;
+	lock_release (&frame_lock);
+	supplemental_page_table_init (&t->spt);
+
+	/* The executable may be written again as soon as the process is gone;
+	 * it is closed once no page reads from it anymore. */
+	corpse->running_file = t->running_file;
+	t->running_file = NULL;
+	if (corpse->running_file != NULL)
+		file_allow_write (corpse->running_file);
+
+	lock_acquire (&corpses_lock);
+	list_push_back (&corpses, &corpse->elem);
+	lock_release (&corpses_lock);
+	sema_up (&reaper_sema);
+	return true;
+}
+
+/* Frees everything CORPSE holds. */
+static void
+tear_down (struct corpse *corpse) {
+	supplemental_page_table_kill (&corpse->spt);
+	hash_destroy (&corpse->spt.pages, NULL);
+	pml4_destroy (corpse->pml4);
+	file_close (corpse->running_file);
+	free (corpse);
+}
+
+/* Returns to the user pool the frames that only pages of CORPSE map,
+ * other than those pinned or being written out.  Their contents are lost,
+ * as no one reads them again.  Returns the number of frames freed. */
+static size_t
+strip (struct corpse *corpse) {
+	struct hash_iterator i;
+	size_t freed = 0;
+
+	lock_acquire (&frame_lock);
+	hash_first (&i, &corpse->spt.pages);
+	while (hash_next (&i)) {
+		struct page *page = hash_entry (hash_cur (&i), struct page, spt_elem);
+		struct frame *frame = page->frame;
+
+		if (frame == NULL || frame->pin_cnt > 0 || frame->evicting)
+			continue;
+		vm_unlink_page (page);
+		if (list_empty (&frame->pages) && frame->cache == NULL) {
+			vm_free_frame (frame);
+			freed++;
+		}
+	}
+	lock_release (&frame_lock);
+	return freed;
+}
+
+/* Frees the frames of queued address spaces, oldest first, until some
+ * frame is freed.  Returns false if none could be.  Called when no free
+ * frame is left, by a thread that may hold a file system lock, so that
+ * closing files and freeing swap slots and page tables is left to the
+ * reaper. */
+bool
+reaper_reclaim (void) {
+	struct list_elem *e;
+	size_t freed = 0;
+
+	/* The reaper does not take a corpse off the queue while it is being
+	 * stripped. */
+	lock_acquire (&corpses_lock);
+	for (e = list_begin (&corpses); freed == 0 && e != list_end (&corpses);
+			e = list_next (e))
+		freed = strip (list_entry (e, struct corpse, elem));
+	lock_release (&corpses_lock);
+
+	reaper_stats.on_demand += freed;
+	return freed > 0;
+}
+
+/* Prints address space teardown statistics. */
+void
+reaper_print_stats (void) {
+	printf ("Reaper: %llu address spaces freed in the background, "
+			"%llu frames on demand\n", reaper_stats.background,
+			reaper_stats.on_demand);
+}
+
+/* The reaper.  Tears down queued address spaces one at a time.  Frames go
+ * back to the user pool one page at a time, each under a short hold of
+ * frame_lock, so that the reaper never holds up faults for long. */
+static void
+reaper (void *aux UNUSED) {
+	for (;;) {
+		struct corpse *corpse = NULL;
+
+		sema_down (&reaper_sema);
+		lock_acquire (&corpses_lock);
+		if (!list_empty (&corpses))
+			corpse = list_entry (list_pop_front (&corpses), struct corpse,
+					elem);
+		lock_release (&corpses_lock);
+
+		ASSERT (corpse != NULL);
+		tear_down (corpse);
+		reaper_stats.background++;
+	}
+}
@@ -1,5 +1,11 @@
 vm_SRC = vm/vm.c          # Main api proxy
 vm_SRC += vm/uninit.c     # Uninitialized page
+vm_SRC += vm/vma.c        # Virtual memory areas
 vm_SRC += vm/anon.c       # Anonymous page
+vm_SRC += vm/zswap.c      # Compressed swap cache
 vm_SRC += vm/file.c       # File mapped page
+vm_SRC += vm/ksm.c        # Same-page merging
+vm_SRC += vm/fault.c      # Page fault statistics
+vm_SRC += vm/kswapd.c     # Page-out daemon
+vm_SRC += vm/reaper.c     # Deferred address space teardown
 vm_SRC += vm/inspect.c    # Testing utility
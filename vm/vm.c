@@ -1,8 +1,41 @@
 /* vm.c: Generic interface for virtual memory objects. */
 
+#include <string.h>
+#include <syscall-nr.h>
+#include "devices/timer.h"
+#include "intrinsic.h"
 #include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
 #include "vm/vm.h"
+#include "vm/fault.h"
 #include "vm/inspect.h"
+#include "vm/ksm.h"
+#include "vm/kswapd.h"
+#include "vm/reaper.h"
+
+/* Maximum number of pages mapped around a file-backed fault. */
+size_t vm_fault_around_max = 16;
+
+/* Default resident page limit of a process, 0 for none. */
+size_t vm_rss_limit;
+
+/* Ticks between two working set estimates of a process. */
+#define WSS_INTERVAL (TIMER_FREQ / 2)
+
+/* Every frame that currently holds a user page, in clock order. */
+struct list frame_table;
+struct lock frame_lock;
+static struct list_elem *clock_hand;
+
+/* Signaled, under frame_lock, whenever the evictor has finished with a
+ * frame. */
+struct condition frame_evicted;
+
+/* Kernel page of zeros, mapped read-only at untouched anonymous pages
+ * until they are first written. */
+static void *zero_page;
 
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
@@ -10,12 +43,20 @@ void
 vm_init (void) {
 	vm_anon_init ();
 	vm_file_init ();
-#ifdef EFILESYS  /* For project 4 */
-	pagecache_init ();
-#endif
 	register_inspect_intr ();
 	/* DO NOT MODIFY UPPER LINES. */
 	/* TODO: Your code goes here. */
+	list_init (&frame_table);
+	clock_hand = NULL;
+	lock_init (&frame_lock);
+	cond_init (&frame_evicted);
+	zero_page = palloc_get_page (PAL_ZERO);
+	if (zero_page == NULL)
+		PANIC ("cannot allocate the zero page");
+	ksm_init ();
+	kswapd_init ();
+	reaper_init ();
+	pagecache_init ();
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -33,9 +74,14 @@ page_get_type (struct page *page) {
 }
 
 /* Helpers */
-static struct frame *vm_get_victim (void);
+static struct frame *vm_get_victim (struct supplemental_page_table *own);
 static bool vm_do_claim_page (struct page *page);
-static struct frame *vm_evict_frame (void);
+static bool vm_load_page (struct page *page, bool evict);
+static bool vm_map_frame (struct page *page, struct frame *frame);
+static bool vm_unshare_page (struct page *page);
+static struct frame *vm_evict_frame (struct supplemental_page_table *own);
+static void vm_fault_around (struct supplemental_page_table *spt,
+		struct page *page, struct inode *inode, off_t ofs);
 
 /* Create the pending page object with initializer. If you want to create a
  * page, do not create it directly and make it through this function or
@@ -50,11 +96,37 @@ vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable,
 
 	/* Check wheter the upage is already occupied or not. */
 	if (spt_find_page (spt, upage) == NULL) {
-		/* TODO: Create the page, fetch the initialier according to the VM type,
-		 * TODO: and then create "uninit" page struct by calling uninit_new. You
-		 * TODO: should modify the field after calling the uninit_new. */
+		bool (*initializer) (struct page *, enum vm_type, void *);
+		struct page *page;
+
+		switch (VM_TYPE (type)) {
+			case VM_ANON:
+				initializer = anon_initializer;
+				break;
+			case VM_FILE:
+				initializer = file_backed_initializer;
+				break;
+			default:
+				goto err;
+		}
 
-		/* TODO: Insert the page into the spt. */
+		page = malloc (sizeof *page);
+		if (page == NULL)
+			goto err;
+		uninit_new (page, upage, init, type, aux, initializer);
+		page->spt = spt;
+		page->pml4 = thread_current ()->pml4;
+		page->writable = writable;
+		page->advice = MADV_NORMAL;
+
+		if (!spt_insert_page (spt, page)) {
+			free (page);
+			goto err;
+		}
+		page->vma = vma_find (spt, upage);
+		if (page->vma != NULL)
+			list_push_back (&page->vma->pages, &page->vma_elem);
+		return true;
 	}
 err:
 	return false;
@@ -62,46 +134,308 @@ err:
 
 /* Find VA from spt and return page. On error, return NULL. */
 struct page *
-spt_find_page (struct supplemental_page_table *spt UNUSED, void *va UNUSED) {
-	struct page *page = NULL;
-	/* TODO: Fill this function. */
+spt_find_page (struct supplemental_page_table *spt, void *va) {
+	struct page key;
+	struct hash_elem *e;
 
-	return page;
+	key.va = pg_round_down (va);
+	e = hash_find (&spt->pages, &key.spt_elem);
+	return e != NULL ? hash_entry (e, struct page, spt_elem) : NULL;
 }
 
 /* Insert PAGE into spt with validation. */
 bool
-spt_insert_page (struct supplemental_page_table *spt UNUSED,
-		struct page *page UNUSED) {
-	int succ = false;
-	/* TODO: Fill this function. */
+spt_insert_page (struct supplemental_page_table *spt, struct page *page) {
+	ASSERT (pg_ofs (page->va) == 0);
 
-	return succ;
+	return hash_insert (&spt->pages, &page->spt_elem) == NULL;
 }
 
 void
 spt_remove_page (struct supplemental_page_table *spt, struct page *page) {
+	hash_delete (&spt->pages, &page->spt_elem);
+	if (page->vma != NULL)
+		list_remove (&page->vma_elem);
 	vm_dealloc_page (page);
+}
+
+/* Moves the accessed bit of PAGE's mapping into its soft bits, so that
+ * the clock and the working set estimate both see an access, whichever of
+ * them reads the page table first.  Must be called with frame_lock
+ * held. */
+static void
+page_take_accessed (struct page *page) {
+	if (pml4_is_accessed (page->pml4, page->va)) {
+		pml4_set_accessed (page->pml4, page->va, false);
+		page->clock_ref = page->wss_ref = true;
+	}
+}
+
+/* Returns true if any page mapping FRAME, or the file system for a page
+ * cache frame, accessed it since the last call. */
+static bool
+frame_accessed (struct frame *frame) {
+	bool accessed = false;
+	struct list_elem *e;
+
+	if (frame->cache != NULL && frame->cache->page_cache.accessed) {
+		frame->cache->page_cache.accessed = false;
+		accessed = true;
+	}
+
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, frame_elem);
+
+		page_take_accessed (page);
+		if (page->clock_ref) {
+			page->clock_ref = false;
+			accessed = true;
+		}
+	}
+	return accessed;
+}
+
+/* Returns the process whose page alone maps FRAME, or NULL if FRAME is
+ * shared. */
+static struct supplemental_page_table *
+frame_owner (struct frame *frame) {
+	return list_size (&frame->pages) == 1 ? frame->page->spt : NULL;
+}
+
+/* Frame filter for the clock: is FRAME owned by the process SPT? */
+static bool
+owned_by (struct frame *frame, void *spt) {
+	return frame_owner (frame) == spt;
+}
+
+/* Frame filter for the clock: does FRAME belong to a process over its
+ * resident limit, or hold a page outside the estimated working set of a
+ * process with more pages resident than that? */
+static bool
+over_budget (struct frame *frame, void *aux UNUSED) {
+	struct supplemental_page_table *spt = frame_owner (frame);
+
+	return spt != NULL
+		&& ((spt->rss_limit != 0 && spt->rss > spt->rss_limit)
+			|| (spt->rss > spt->wss && !frame->page->in_wss));
+}
+
+/* Frame filter for the clock: is FRAME mapped only by pages advised to be
+ * accessed sequentially, which are unlikely to be read again once the
+ * reader has moved past them? */
+static bool
+advised_sequential (struct frame *frame, void *aux UNUSED) {
+	struct list_elem *e;
+
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e))
+		if (list_entry (e, struct page, frame_elem)->advice != MADV_SEQUENTIAL)
+			return false;
 	return true;
 }
 
-/* Get the struct frame, that will be evicted. */
+/* Second-chance clock: advances the hand over at most SWEEPS revolutions
+ * and returns the first frame not accessed since the hand last passed it,
+ * clearing the accessed bits of those that were.  If FILTER is nonnull,
+ * only frames for which it returns true are considered.  Pinned frames are
+ * passed over. */
 static struct frame *
-vm_get_victim (void) {
-	struct frame *victim = NULL;
-	 /* TODO: The policy for eviction is up to you. */
+clock_find (bool (*filter) (struct frame *, void *), void *aux,
+		size_t sweeps) {
+	size_t limit = sweeps * list_size (&frame_table);
+	size_t scanned;
+
+	for (scanned = 0; scanned < limit; scanned++) {
+		struct frame *frame;
+
+		if (clock_hand == NULL || clock_hand == list_end (&frame_table))
+			clock_hand = list_begin (&frame_table);
+		frame = list_entry (clock_hand, struct frame, elem);
+		clock_hand = list_next (clock_hand);
+
+		if (frame->pin_cnt == 0 && (filter == NULL || filter (frame, aux))
+				&& !frame_accessed (frame))
+			return frame;
+	}
+	return NULL;
+}
 
+/* Get the struct frame, that will be evicted.  If OWN is nonnull, only a
+ * frame of that process is picked, and NULL is returned if there is none.
+ * Otherwise pages advised to be read sequentially go first, then those of
+ * processes over their budget; two sweeps over all frames always find a
+ * victim. */
+static struct frame *
+vm_get_victim (struct supplemental_page_table *own) {
+	struct frame *victim;
+
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	if (own != NULL)
+		return clock_find (owned_by, own, 2);
+	victim = clock_find (advised_sequential, NULL, 1);
+	if (victim == NULL)
+		victim = clock_find (over_budget, NULL, 1);
+	if (victim == NULL)
+		victim = clock_find (NULL, NULL, 2);
 	return victim;
 }
 
-/* Evict one page and return the corresponding frame.
+/* Picks a page to evict and takes its frame out of the frame table, with
+ * frame_lock held.  If OWN is nonnull, the page is one of that process's.
+ * Returns NULL if there is nothing to evict.
+ * The frame is unmapped from every process and marked evicting: until
+ * vm_evict_end (), faults on its pages and lookups of its page cache page
+ * wait, and nothing else changes its pages, so that vm_evict_write () can
+ * write it out without the lock. */
+static struct frame *
+vm_evict_begin (struct supplemental_page_table *own) {
+	struct frame *victim;
+	struct list_elem *e;
+
+	victim = vm_get_victim (own);
+	if (victim == NULL)
+		return NULL;
+	if (clock_hand == &victim->elem)
+		clock_hand = list_next (clock_hand);
+	ksm_forget_frame (victim);
+	list_remove (&victim->elem);
+	victim->evicting = true;
+
+	/* A page cache page is unmapped from all its mappings and written
+	 * back once for all of them; each merged anonymous page gets a swap
+	 * slot of its own. */
+	if (victim->cache != NULL)
+		page_cache_evict (victim);
+	for (e = list_begin (&victim->pages); e != list_end (&victim->pages);
+			e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, frame_elem);
+
+		pml4_clear_page (page->pml4, page->va);
+		page->spt->rss--;
+	}
+	return victim;
+}
+
+/* Writes out the contents of VICTIM, taken by vm_evict_begin (), to the
+ * backing store of each of its pages.  Called without frame_lock. */
+static void
+vm_evict_write (struct frame *victim) {
+	struct list_elem *e;
+
+	if (victim->cache != NULL && !swap_out (victim->cache))
+		PANIC ("cannot write back page cache page");
+	for (e = list_begin (&victim->pages); e != list_end (&victim->pages);
+			e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, frame_elem);
+
+		if (!swap_out (page))
+			PANIC ("cannot evict page at %p", page->va);
+	}
+}
+
+/* Detaches VICTIM, written out by vm_evict_write (), from its pages and
+ * wakes up whoever waits for them.  VICTIM is free for reuse afterward.
+ * Must be called with frame_lock held. */
+static void
+vm_evict_end (struct frame *victim) {
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	if (victim->cache != NULL)
+		page_cache_evict_end (victim);
+	while (!list_empty (&victim->pages))
+		list_entry (list_pop_front (&victim->pages), struct page,
+				frame_elem)->frame = NULL;
+	victim->page = NULL;
+	victim->evicting = false;
+	cond_broadcast (&frame_evicted, &frame_lock);
+}
+
+/* Evict one page and return the corresponding frame.  If OWN is nonnull,
+ * the page is one of that process's.  The swap or file write happens
+ * without frame_lock, so faults elsewhere are not held up by it.
  * Return NULL on error.*/
 static struct frame *
-vm_evict_frame (void) {
-	struct frame *victim UNUSED = vm_get_victim ();
-	/* TODO: swap out the victim and return the evicted frame. */
+vm_evict_frame (struct supplemental_page_table *own) {
+	struct frame *victim;
 
-	return NULL;
+	lock_acquire (&frame_lock);
+	victim = vm_evict_begin (own);
+	lock_release (&frame_lock);
+
+	if (victim != NULL) {
+		vm_evict_write (victim);
+		lock_acquire (&frame_lock);
+		vm_evict_end (victim);
+		lock_release (&frame_lock);
+	}
+	return victim;
+}
+
+/* Evicts up to CNT pages in one go and returns their frames to the user
+ * pool.  The victims are all picked under one hold of frame_lock, then
+ * the swap and file writes of the batch go out back to back without it.
+ * Returns the number of frames freed. */
+size_t
+vm_reclaim (size_t cnt) {
+	struct list victims;
+	struct list_elem *e;
+	size_t freed = 0;
+
+	list_init (&victims);
+	lock_acquire (&frame_lock);
+	while (freed < cnt) {
+		struct frame *victim = vm_evict_begin (NULL);
+		if (victim == NULL)
+			break;
+		list_push_back (&victims, &victim->elem);
+		freed++;
+	}
+	lock_release (&frame_lock);
+
+	for (e = list_begin (&victims); e != list_end (&victims);
+			e = list_next (e))
+		vm_evict_write (list_entry (e, struct frame, elem));
+
+	lock_acquire (&frame_lock);
+	for (e = list_begin (&victims); e != list_end (&victims);
+			e = list_next (e))
+		vm_evict_end (list_entry (e, struct frame, elem));
+	lock_release (&frame_lock);
+
+	while (!list_empty (&victims))
+		vm_discard_frame (list_entry (list_pop_front (&victims),
+					struct frame, elem));
+	return freed;
+}
+
+/* Returns a free frame from the user pool, or NULL if the pool is
+ * exhausted.  Never evicts, but wakes the page-out daemon when free frames
+ * run low. */
+static struct frame *
+vm_get_free_frame (void) {
+	struct frame *frame;
+	void *kva;
+
+	kswapd_check ();
+	kva = palloc_get_page (PAL_USER);
+	if (kva == NULL)
+		return NULL;
+	frame = malloc (sizeof *frame);
+	if (frame == NULL) {
+		palloc_free_page (kva);
+		return NULL;
+	}
+	frame->kva = kva;
+	frame->page = NULL;
+	list_init (&frame->pages);
+	frame->cache = NULL;
+	frame->pin_cnt = 0;
+	frame->evicting = false;
+	frame->checksum = 0;
+	frame->ksm_listed = false;
+	return frame;
 }
 
 /* palloc() and get frame. If there is no available page, evict the page
@@ -109,35 +443,461 @@ vm_evict_frame (void) {
  * memory is full, this function evicts the frame to get the available memory
  * space.*/
 static struct frame *
-vm_get_frame (void) {
+vm_get_frame (struct supplemental_page_table *spt) {
 	struct frame *frame = NULL;
-	/* TODO: Fill this function. */
 
-	ASSERT (frame != NULL);
+	/* A process at its resident limit replaces its own pages. */
+	if (spt != NULL && spt->rss_limit != 0 && spt->rss >= spt->rss_limit)
+		frame = vm_evict_frame (spt);
+	if (frame == NULL)
+		frame = vm_get_free_frame ();
+
+	/* Memory of exited processes the reaper has not got to yet goes
+	 * before pages in use. */
+	while (frame == NULL && reaper_reclaim ())
+		frame = vm_get_free_frame ();
+	while (frame == NULL) {
+		/* The page-out daemon fell behind: the faulting thread has to
+		 * write a page out itself. */
+		frame = vm_evict_frame (NULL);
+		if (frame != NULL) {
+			reclaim_stats.direct++;
+			break;
+		}
+
+		/* Every frame is pinned, or being filled or written out by
+		 * another thread.  Sleep rather than yield, so that their
+		 * holders get to run whatever their priority, then try again. */
+		timer_sleep (1);
+		frame = vm_get_free_frame ();
+	}
+
 	ASSERT (frame->page == NULL);
 	return frame;
 }
 
+/* Returns a frame for a page of the process SPT, which may be null for
+ * pages of no process.  Unless EVICT, only a free frame is returned, or
+ * NULL if there is none.  The frame is not in the frame table yet. */
+struct frame *
+vm_alloc_frame (struct supplemental_page_table *spt, bool evict) {
+	return evict ? vm_get_frame (spt) : vm_get_free_frame ();
+}
+
+/* Returns FRAME, which never entered the frame table or has left it, to
+ * the user pool. */
+void
+vm_discard_frame (struct frame *frame) {
+	palloc_free_page (frame->kva);
+	free (frame);
+}
+
+/* Removes FRAME, which no page maps anymore, from the frame table and
+ * returns it to the user pool.  Must be called with frame_lock held. */
+void
+vm_free_frame (struct frame *frame) {
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+	ASSERT (list_empty (&frame->pages));
+
+	if (clock_hand == &frame->elem)
+		clock_hand = list_next (clock_hand);
+	ksm_forget_frame (frame);
+	list_remove (&frame->elem);
+	vm_discard_frame (frame);
+}
+
+/* Unmaps PAGE and removes it from the pages of its frame, leaving the
+ * frame in place.  What the process wrote to a page cache frame is
+ * recorded in its cache page.  Must be called with frame_lock held. */
+void
+vm_unlink_page (struct page *page) {
+	struct frame *frame = page->frame;
+
+	if (frame->cache != NULL && pml4_is_dirty (page->pml4, page->va))
+		page_cache_mark_dirty (frame->cache);
+	list_remove (&page->frame_elem);
+	pml4_clear_page (page->pml4, page->va);
+	page->frame = NULL;
+	page->spt->rss--;
+	if (frame->page == page)
+		frame->page = list_empty (&frame->pages) ? NULL
+			: list_entry (list_front (&frame->pages), struct page, frame_elem);
+}
+
+/* Waits until the evictor is done with the frame of PAGE, if it is
+ * writing it out.  Must be called with frame_lock held. */
+void
+vm_wait_evicted (struct page *page) {
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	while (page->frame != NULL && page->frame->evicting)
+		cond_wait (&frame_evicted, &frame_lock);
+}
+
+/* Returns true if PAGE has no frame of its own yet and reads as the zero
+ * page. */
+static bool
+is_zero_mapped (struct page *page) {
+	return page->frame == NULL && page->pml4 != NULL
+		&& pml4_get_page (page->pml4, page->va) == zero_page;
+}
+
+/* Detaches PAGE from its frame, if it has one, and unmaps it.  The frame
+ * goes back to the user pool once no other process maps it, unless the
+ * page cache keeps it.  Called by the page types' destroy hooks. */
+void
+vm_release_frame (struct page *page) {
+	struct frame *frame;
+
+	/* pml4_destroy () must not free the zero page. */
+	if (is_zero_mapped (page))
+		pml4_clear_page (page->pml4, page->va);
+
+	lock_acquire (&frame_lock);
+	vm_wait_evicted (page);
+	frame = page->frame;
+	if (frame != NULL) {
+		vm_unlink_page (page);
+		if (list_empty (&frame->pages) && frame->cache == NULL)
+			vm_free_frame (frame);
+	}
+	lock_release (&frame_lock);
+}
+
 /* Growing the stack. */
 static void
-vm_stack_growth (void *addr UNUSED) {
+vm_stack_growth (void *addr) {
+	void *upage = pg_round_down (addr);
+
+	if (vm_alloc_page (VM_ANON | VM_STACK, upage, true))
+		vm_claim_page (upage);
 }
 
 /* Handle the fault on write_protected page */
 static bool
-vm_handle_wp (struct page *page UNUSED) {
+vm_handle_wp (struct page *page) {
+	/* The first write to a page that has only been read so far: give it a
+	 * zeroed frame of its own. */
+	if (is_zero_mapped (page)) {
+		pml4_clear_page (page->pml4, page->va);
+		return vm_do_claim_page (page);
+	}
+	if (page_get_type (page) == VM_ANON)
+		return vm_unshare_page (page);
+	return false;
 }
 
-/* Return true on success */
-bool
-vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
-		bool user UNUSED, bool write UNUSED, bool not_present UNUSED) {
-	struct supplemental_page_table *spt UNUSED = &thread_current ()->spt;
+/* Gives PAGE, a writable anonymous page that was write-protected for
+ * merging, back write access.  If other pages were merged into its frame,
+ * it gets a private copy of the frame first. */
+static bool
+vm_unshare_page (struct page *page) {
+	struct frame *frame, *copy = NULL;
+
+	lock_acquire (&frame_lock);
+	vm_wait_evicted (page);
+	frame = page->frame;
+	if (frame != NULL && list_size (&frame->pages) > 1) {
+		/* Cannot evict while holding the lock. */
+		lock_release (&frame_lock);
+		copy = vm_get_frame (page->spt);
+		lock_acquire (&frame_lock);
+		vm_wait_evicted (page);
+		frame = page->frame;
+	}
+
+	/* The frame may have been evicted, or the other pages unmapped, while
+	 * the lock was released.  In the first case the page is simply
+	 * faulted in again. */
+	if (frame != NULL && list_size (&frame->pages) > 1) {
+		memcpy (copy->kva, frame->kva, PGSIZE);
+		vm_unlink_page (page);
+		vm_map_frame (page, copy);
+		list_push_back (&frame_table, &copy->elem);
+		ksm_stats.broken++;
+		copy = NULL;
+	} else if (frame != NULL)
+		pml4_set_writable (page->pml4, page->va, true);
+	lock_release (&frame_lock);
+
+	if (copy != NULL)
+		vm_discard_frame (copy);
+	return true;
+}
+
+/* Returns true if PAGE is anonymous memory that has never been touched,
+ * so it reads as all zeros. */
+static bool
+is_untouched_anon (struct page *page) {
+	return VM_TYPE (page->operations->type) == VM_UNINIT
+		&& VM_TYPE (page->uninit.type) == VM_ANON
+		&& page->uninit.init == NULL;
+}
+
+/* Estimates the working set of the process owning SPT, at most once every
+ * WSS_INTERVAL ticks, as the number of its pages accessed since the
+ * previous estimate, and marks those pages as in it.  The accessed bits
+ * taken from the page table are left for the clock in the pages. */
+static void
+vm_sample_wss (struct supplemental_page_table *spt) {
+	struct hash_iterator i;
+	size_t accessed = 0;
+
+	if (timer_elapsed (spt->wss_stamp) < WSS_INTERVAL)
+		return;
+
+	lock_acquire (&frame_lock);
+	hash_first (&i, &spt->pages);
+	while (hash_next (&i)) {
+		struct page *page = hash_entry (hash_cur (&i), struct page, spt_elem);
+
+		if (page->frame != NULL)
+			page_take_accessed (page);
+		page->in_wss = page->wss_ref;
+		page->wss_ref = false;
+		if (page->in_wss)
+			accessed++;
+	}
+	spt->wss = accessed;
+	spt->wss_stamp = timer_ticks ();
+	lock_release (&frame_lock);
+}
+
+/* Return true if ADDR, faulted on with user stack pointer RSP, is a
+ * plausible access to the not-yet-allocated part of the stack of the
+ * process SPT. */
+static bool
+is_stack_access (struct supplemental_page_table *spt, void *addr,
+		uintptr_t rsp) {
+	struct vma *vma = vma_find (spt, addr);
+
+	return vma != NULL && (vma->flags & VMA_STACK)
+		&& (uintptr_t) addr >= rsp - 8;
+}
+
+/* Returns the class of a not-present fault on PAGE, which is about to be
+ * brought in. */
+static int
+claim_fault_class (struct page *page) {
+	if (VM_TYPE (page->operations->type) == VM_UNINIT)
+		return is_untouched_anon (page) ? FAULT_ZERO_FILL : FAULT_LAZY_LOAD;
+	return page_get_type (page) == VM_ANON ? FAULT_SWAP_IN : FAULT_FILE_IN;
+}
+
+/* Handles a fault at ADDR in the process SPT, like vm_try_handle_fault (),
+ * and stores its FAULT_* class in *CLS if it was valid. */
+static bool
+vm_handle_fault (struct supplemental_page_table *spt, struct intr_frame *f,
+		void *addr, bool user, bool write, bool not_present, int *cls) {
 	struct page *page = NULL;
+	struct inode *inode;
+	off_t ofs;
+	bool file_fault;
+
 	/* TODO: Validate the fault */
-	/* TODO: Your code goes here */
+	if (addr == NULL || !is_user_vaddr (addr))
+		return false;
+	vm_sample_wss (spt);
 
-	return vm_do_claim_page (page);
+	page = spt_find_page (spt, addr);
+	if (page == NULL) {
+		uintptr_t rsp = user ? f->rsp : thread_current ()->user_rsp;
+		if (!not_present || !is_stack_access (spt, addr, rsp))
+			return false;
+		*cls = FAULT_STACK_GROWTH;
+		vm_stack_growth (addr);
+		return spt_find_page (spt, addr) != NULL;
+	}
+
+	if (write && !page->writable)
+		return false;
+	if (!not_present) {
+		*cls = FAULT_COW;
+		return vm_handle_wp (page);
+	}
+
+	if (page->frame != NULL) {
+		/* The page is being evicted.  Wait until it has been written out
+		 * before reading it back in. */
+		lock_acquire (&frame_lock);
+		vm_wait_evicted (page);
+		lock_release (&frame_lock);
+	}
+
+	/* Reading zeros takes no memory of its own. */
+	*cls = claim_fault_class (page);
+	if (!write && is_untouched_anon (page))
+		return pml4_set_page (page->pml4, page->va, zero_page, false);
+
+	/* Where the page comes from has to be looked up before the claim: a
+	 * lazily loaded page forgets it once it has been read. */
+	file_fault = file_page_source (page, &inode, &ofs);
+	if (!vm_do_claim_page (page))
+		return false;
+	if (file_fault)
+		vm_fault_around (spt, page, inode, ofs);
+	return true;
+}
+
+/* Return true on success.  Each fault is counted in its class, along with
+ * the time it took to handle. */
+bool
+vm_try_handle_fault (struct intr_frame *f, void *addr,
+		bool user, bool write, bool not_present) {
+	struct thread *t = thread_current ();
+	uint64_t start = rdtsc ();
+	int cls = FAULT_INVALID;
+	bool success;
+
+	success = vm_handle_fault (&t->spt, f, addr, user, write, not_present,
+			&cls);
+	fault_record (t->is_process ? &t->spt : NULL,
+			success ? cls : FAULT_INVALID, rdtsc () - start);
+	return success;
+}
+
+/* Maps the pages following PAGE, which was just faulted in from INODE at
+ * offset OFS, as long as they continue the same run of the same file, have
+ * not been loaded yet and free frames are at hand.  The window doubles each
+ * time the process faults exactly where the previous window ended and is
+ * halved on any other file-backed fault, so sequential scans take one trap
+ * per window while random access degrades to plain demand paging.  Pages
+ * advised MADV_SEQUENTIAL get the largest window right away, those advised
+ * MADV_RANDOM none at all. */
+static void
+vm_fault_around (struct supplemental_page_table *spt, struct page *page,
+		struct inode *inode, off_t ofs) {
+	size_t i;
+
+	if (vm_fault_around_max == 0 || page->advice == MADV_RANDOM)
+		return;
+
+	if (page->advice == MADV_SEQUENTIAL)
+		spt->fa_window = vm_fault_around_max;
+	else if (page->va == spt->fa_next)
+		spt->fa_window = spt->fa_window ? spt->fa_window * 2 : 1;
+	else
+		spt->fa_window /= 2;
+	if (spt->fa_window > vm_fault_around_max)
+		spt->fa_window = vm_fault_around_max;
+
+	for (i = 1; i <= spt->fa_window; i++) {
+		void *va = (uint8_t *) page->va + i * PGSIZE;
+		struct page *next;
+		struct inode *next_inode;
+		off_t next_ofs;
+
+		if (!is_user_vaddr (va))
+			break;
+		next = spt_find_page (spt, va);
+		if (next == NULL || next->frame != NULL
+				|| next->advice == MADV_RANDOM
+				|| !file_page_source (next, &next_inode, &next_ofs)
+				|| next_inode != inode
+				|| next_ofs != ofs + (off_t) (i * PGSIZE))
+			break;
+
+		/* Speculative pages never push out resident ones, nor take a
+		 * process over its resident limit. */
+		if (spt->rss_limit != 0 && spt->rss >= spt->rss_limit)
+			break;
+		if (!vm_load_page (next, false))
+			break;
+	}
+	spt->fa_next = (uint8_t *) page->va + i * PGSIZE;
+}
+
+/* Brings PAGE in ahead of its first access, if a free frame is at hand.
+ * Advice never pushes out pages in actual use, nor takes a process over
+ * its resident limit. */
+static void
+vm_prefetch_page (struct page *page) {
+	struct supplemental_page_table *spt = page->spt;
+
+	if (page->frame != NULL || is_untouched_anon (page))
+		return;
+	if (spt->rss_limit != 0 && spt->rss >= spt->rss_limit)
+		return;
+	vm_load_page (page, false);
+}
+
+/* Throws away the contents of PAGE, a page of the running process.  A
+ * file-backed page is written back and read from its file again on the next
+ * access; anonymous memory becomes untouched again and reads as zeros. */
+static void
+vm_discard_page (struct supplemental_page_table *spt, struct page *page) {
+	void *va = page->va;
+	uint64_t *pml4 = page->pml4;
+	bool writable = page->writable;
+	int advice = page->advice;
+	struct vma *vma = page->vma;
+	enum vm_type type;
+
+	if (VM_TYPE (page->operations->type) == VM_FILE) {
+		file_page_drop (page);
+		return;
+	}
+
+	/* Pages still waiting for their first load have nothing to drop. */
+	if (VM_TYPE (page->operations->type) != VM_ANON)
+		return;
+
+	/* Reuse the page in place: unlike allocating a new one, this cannot
+	 * fail halfway and leave the address unmapped.  Markers such as
+	 * VM_STACK stay. */
+	type = page->anon.type;
+	hash_delete (&spt->pages, &page->spt_elem);
+	if (vma != NULL)
+		list_remove (&page->vma_elem);
+	destroy (page);
+	uninit_new (page, va, NULL, type, NULL, anon_initializer);
+	page->spt = spt;
+	page->pml4 = pml4;
+	page->writable = writable;
+	page->advice = advice;
+	page->vma = vma;
+	if (vma != NULL)
+		list_push_back (&vma->pages, &page->vma_elem);
+	spt_insert_page (spt, page);
+}
+
+/* Applies ADVICE, one of the MADV_* values, to the pages of the running
+ * process from ADDR, which must be page-aligned, up to ADDR + LENGTH.
+ * MADV_WILLNEED and MADV_DONTNEED act on the pages right away; the others
+ * stay with the pages and steer fault-around and eviction.  Unmapped pages
+ * in the range are skipped.  Returns false if the arguments are invalid or
+ * any page in the range was not mapped. */
+bool
+vm_advise (void *addr, size_t length, int advice) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	uint8_t *va, *end = (uint8_t *) addr + length;
+	bool success = true;
+
+	if (pg_ofs (addr) != 0 || length == 0
+			|| advice < MADV_NORMAL || advice > MADV_DONTNEED)
+		return false;
+	if (end < (uint8_t *) addr || !is_user_vaddr (end - 1))
+		return false;
+
+	for (va = addr; va < end; va += PGSIZE) {
+		struct page *page = spt_find_page (spt, va);
+
+		if (page == NULL) {
+			success = false;
+			continue;
+		}
+		switch (advice) {
+			case MADV_WILLNEED:
+				vm_prefetch_page (page);
+				break;
+			case MADV_DONTNEED:
+				vm_discard_page (spt, page);
+				break;
+			default:
+				page->advice = advice;
+		}
+	}
+	return success;
 }
 
 /* Free the page.
@@ -150,41 +910,213 @@ vm_dealloc_page (struct page *page) {
 
 /* Claim the page that allocate on VA. */
 bool
-vm_claim_page (void *va UNUSED) {
+vm_claim_page (void *va) {
 	struct page *page = NULL;
-	/* TODO: Fill this function */
 
+	page = spt_find_page (&thread_current ()->spt, va);
+	if (page == NULL)
+		return false;
 	return vm_do_claim_page (page);
 }
 
 /* Claim the PAGE and set up the mmu. */
 static bool
 vm_do_claim_page (struct page *page) {
-	struct frame *frame = vm_get_frame ();
+	return vm_load_page (page, true);
+}
+
+/* Brings PAGE into a frame and maps it.  A page that maps its file as it
+ * is maps the file's frame in the page cache, shared with every process
+ * mapping the same part of the file and with reads and writes through the
+ * file system.  Unless EVICT, only a free frame is used and false is
+ * returned if there is none. */
+static bool
+vm_load_page (struct page *page, bool evict) {
+	struct frame *frame;
+	struct inode *inode;
+	off_t ofs;
+	bool success = false;
+
+	if (file_cache_source (page, &inode, &ofs)) {
+		frame = page_cache_get (inode, ofs, page->spt, evict);
+		if (frame == NULL)
+			return false;
+		file_cache_attach (page);
+		lock_acquire (&frame_lock);
+		success = vm_map_frame (page, frame);
+		lock_release (&frame_lock);
+		page_cache_put (frame, false);
+		return success;
+	}
+
+	frame = vm_alloc_frame (page->spt, evict);
+	if (frame == NULL)
+		return false;
 
 	/* Set links */
 	frame->page = page;
 	page->frame = frame;
 
-	/* TODO: Insert page table entry to map page's VA to frame's PA. */
+	/* The frame enters the frame table only once it is filled, so the
+	 * clock never picks a frame that is still being filled. */
+	success = swap_in (page, frame->kva);
+	page->frame = NULL;
+	frame->page = NULL;
+	if (!success) {
+		vm_discard_frame (frame);
+		return false;
+	}
+
+	lock_acquire (&frame_lock);
+	list_push_back (&frame_table, &frame->elem);
+	success = vm_map_frame (page, frame);
+	if (!success)
+		vm_free_frame (frame);
+	lock_release (&frame_lock);
+	return success;
+}
+
+/* Maps FRAME, which already holds PAGE's contents, at PAGE.  Must be
+ * called with frame_lock held. */
+static bool
+vm_map_frame (struct page *page, struct frame *frame) {
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	if (!pml4_set_page (page->pml4, page->va, frame->kva, page->writable))
+		return false;
+	page->frame = frame;
+	if (list_empty (&frame->pages))
+		frame->page = page;
+	list_push_back (&frame->pages, &page->frame_elem);
+	page->spt->rss++;
+	return true;
+}
+
+/* Returns a hash value for the page that E belongs to. */
+static uint64_t
+page_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct page *page = hash_entry (e, struct page, spt_elem);
+	return hash_bytes (&page->va, sizeof page->va);
+}
 
-	return swap_in (page, frame->kva);
+/* Orders pages by user virtual address. */
+static bool
+page_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return hash_entry (a, struct page, spt_elem)->va
+		< hash_entry (b, struct page, spt_elem)->va;
 }
 
 /* Initialize new supplemental page table */
 void
-supplemental_page_table_init (struct supplemental_page_table *spt UNUSED) {
+supplemental_page_table_init (struct supplemental_page_table *spt) {
+	hash_init (&spt->pages, page_hash, page_less, NULL);
+	spt->fa_next = NULL;
+	spt->fa_window = 1;
+	spt->rss = 0;
+	spt->rss_limit = vm_rss_limit;
+	spt->wss = 0;
+	spt->wss_stamp = timer_ticks ();
+	spt->heap_start = spt->brk = NULL;
+	spt->vmas = NULL;
+	spt->heap = NULL;
+	memset (spt->faults, 0, sizeof spt->faults);
+}
+
+/* Copies the contents of SRC, a resident or swapped out page of another
+ * process, into DST, a page of the running one. */
+static bool
+vm_copy_contents (struct page *dst, struct page *src) {
+	for (;;) {
+		/* SRC's frame may still be read while it is written out, but DST's
+		 * must not change under the evictor. */
+		lock_acquire (&frame_lock);
+		vm_wait_evicted (dst);
+		if (dst->frame != NULL && src->frame != NULL) {
+			memcpy (dst->frame->kva, src->frame->kva, PGSIZE);
+			lock_release (&frame_lock);
+			return true;
+		}
+		lock_release (&frame_lock);
+
+		/* Either may be evicted again by the time the other is in. */
+		if (dst->frame == NULL && !vm_do_claim_page (dst))
+			return false;
+		if (src->frame == NULL && !vm_do_claim_page (src))
+			return false;
+	}
+}
+
+/* Sets up a copy of SRC, a page of the parent, in the running process.
+ * Pages that can still be read from their file are copied lazily. */
+static bool
+vm_copy_page (struct page *src) {
+	struct page *dst;
+	bool uninit = VM_TYPE (src->operations->type) == VM_UNINIT;
+	enum vm_type type = uninit ? src->uninit.type
+		: page_get_type (src) == VM_ANON ? src->anon.type
+		: src->operations->type;
+
+	if (page_get_type (src) == VM_FILE
+			|| (uninit && src->uninit.init == file_lazy_load)) {
+		struct file_load_info *info = file_load_info_copy (src);
+
+		if (info == NULL)
+			return false;
+		if (!vm_alloc_page_with_initializer (type, src->va, src->writable,
+					file_lazy_load, info)) {
+			free (info);
+			return false;
+		}
+		/* Changes not written back yet are in the page cache, which the
+		 * child maps as well. */
+		return true;
+	} else if (!vm_alloc_page_with_initializer (type, src->va, src->writable,
+				uninit ? src->uninit.init : NULL,
+				uninit ? src->uninit.aux : NULL))
+		return false;
+	else if (uninit)
+		return true;
+
+	dst = spt_find_page (&thread_current ()->spt, src->va);
+	return vm_copy_contents (dst, src);
 }
 
 /* Copy supplemental page table from src to dst */
 bool
-supplemental_page_table_copy (struct supplemental_page_table *dst UNUSED,
-		struct supplemental_page_table *src UNUSED) {
+supplemental_page_table_copy (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src) {
+	struct hash_iterator i;
+
+	/* Areas first, so that each page finds its own. */
+	if (!vma_copy (dst, src))
+		return false;
+	hash_first (&i, &src->pages);
+	while (hash_next (&i)) {
+		struct page *page = hash_entry (hash_cur (&i), struct page, spt_elem);
+
+		if (!vm_copy_page (page))
+			return false;
+		spt_find_page (dst, page->va)->advice = page->advice;
+	}
+	dst->heap_start = src->heap_start;
+	dst->brk = src->brk;
+	return true;
+}
+
+/* Destroys the page that E belongs to. */
+static void
+spt_destroy_page (struct hash_elem *e, void *aux UNUSED) {
+	vm_dealloc_page (hash_entry (e, struct page, spt_elem));
 }
 
 /* Free the resource hold by the supplemental page table */
 void
-supplemental_page_table_kill (struct supplemental_page_table *spt UNUSED) {
+supplemental_page_table_kill (struct supplemental_page_table *spt) {
 	/* TODO: Destroy all the supplemental_page_table hold by thread and
 	 * TODO: writeback all the modified contents to the storage. */
+	/* Whole areas at a time; then whatever pages were outside any. */
+	vma_kill (spt);
+	hash_clear (&spt->pages, spt_destroy_page);
+	spt->heap_start = spt->brk = NULL;
 }
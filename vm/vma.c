@@ -0,0 +1,280 @@
+/* vma.c: Virtual memory areas of a process, in an interval tree. */
+
+#include "vm/vma.h"
+#include <debug.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
+#include "vm/vm.h"
+
+/* Returns the height of the subtree rooted at N. */
+static int
+height (struct vma *n) {
+	return n != NULL ? n->height : 0;
+}
+
+/* Recomputes the height and largest end of N from its children. */
+static void
+update (struct vma *n) {
+	int hl = height (n->left), hr = height (n->right);
+
+	n->height = (hl > hr ? hl : hr) + 1;
+	n->max_end = (uintptr_t) n->end;
+	if (n->left != NULL && n->left->max_end > n->max_end)
+		n->max_end = n->left->max_end;
+	if (n->right != NULL && n->right->max_end > n->max_end)
+		n->max_end = n->right->max_end;
+}
+
+/* Rotates the subtree rooted at N to the right and returns its new
+ * root. */
+static struct vma *
+rotate_right (struct vma *n) {
+	struct vma *l = n->left;
+
+	n->left = l->right;
+	l->right = n;
+	update (n);
+	update (l);
+	return l;
+}
+
+/* Rotates the subtree rooted at N to the left and returns its new root. */
+static struct vma *
+rotate_left (struct vma *n) {
+	struct vma *r = n->right;
+
+	n->right = r->left;
+	r->left = n;
+	update (n);
+	update (r);
+	return r;
+}
+
+/* Restores the AVL balance of N, whose subtrees are balanced and differ in
+ * height by at most two, and returns the new root of the subtree. */
+static struct vma *
+balance (struct vma *n) {
+	int diff = height (n->left) - height (n->right);
+
+	if (diff > 1) {
+		if (height (n->left->left) < height (n->left->right))
+			n->left = rotate_left (n->left);
+		return rotate_right (n);
+	}
+	if (diff < -1) {
+		if (height (n->right->right) < height (n->right->left))
+			n->right = rotate_right (n->right);
+		return rotate_left (n);
+	}
+	update (n);
+	return n;
+}
+
+/* Inserts NEW into the subtree rooted at N and returns its new root. */
+static struct vma *
+tree_insert (struct vma *n, struct vma *new) {
+	if (n == NULL) {
+		new->left = new->right = NULL;
+		update (new);
+		return new;
+	}
+	if (new->start < n->start)
+		n->left = tree_insert (n->left, new);
+	else
+		n->right = tree_insert (n->right, new);
+	return balance (n);
+}
+
+/* Unlinks the leftmost node of the subtree rooted at N, storing it in
+ * *MIN, and returns the new root. */
+static struct vma *
+tree_remove_min (struct vma *n, struct vma **min) {
+	if (n->left == NULL) {
+		*min = n;
+		return n->right;
+	}
+	n->left = tree_remove_min (n->left, min);
+	return balance (n);
+}
+
+/* Unlinks OLD from the subtree rooted at N and returns the new root. */
+static struct vma *
+tree_remove (struct vma *n, struct vma *old) {
+	ASSERT (n != NULL);
+
+	if (old->start < n->start)
+		n->left = tree_remove (n->left, old);
+	else if (old->start > n->start)
+		n->right = tree_remove (n->right, old);
+	else {
+		struct vma *min;
+
+		ASSERT (n == old);
+		if (n->right == NULL)
+			return n->left;
+		n->right = tree_remove_min (n->right, &min);
+		min->left = n->left;
+		min->right = n->right;
+		n = min;
+	}
+	return balance (n);
+}
+
+/* Returns an area of SPT that overlaps [START, END), or NULL if there is
+ * none. */
+struct vma *
+vma_overlap (struct supplemental_page_table *spt, const void *start,
+		const void *end) {
+	struct vma *n = spt->vmas;
+
+	while (n != NULL) {
+		if (start < n->end && n->start < end)
+			return n;
+
+		/* If anything on the left ends after START but does not
+		 * overlap, it starts at or after END, and so does everything on
+		 * the right. */
+		if (n->left != NULL && n->left->max_end > (uintptr_t) start)
+			n = n->left;
+		else
+			n = n->right;
+	}
+	return NULL;
+}
+
+/* Returns the area of SPT that contains ADDR, or NULL if there is none. */
+struct vma *
+vma_find (struct supplemental_page_table *spt, const void *addr) {
+	return vma_overlap (spt, addr, (const uint8_t *) addr + 1);
+}
+
+/* Returns the area of SPT with the highest start below ADDR, or NULL. */
+static struct vma *
+vma_below (struct supplemental_page_table *spt, const void *addr) {
+	struct vma *n = spt->vmas, *best = NULL;
+
+	while (n != NULL)
+		if (n->start < addr) {
+			best = n;
+			n = n->right;
+		} else
+			n = n->left;
+	return best;
+}
+
+/* Creates an area of SPT from START to END, both page-aligned, with the
+ * given FLAGS.  If FILE is nonnull, the area maps it from offset OFS and
+ * keeps a reference to it of its own.  Returns NULL if the range is empty
+ * or overlaps another area, or if memory runs out. */
+struct vma *
+vma_create (struct supplemental_page_table *spt, void *start, void *end,
+		struct file *file, off_t ofs, int flags) {
+	struct vma *vma;
+
+	ASSERT (pg_ofs (start) == 0 && pg_ofs (end) == 0);
+
+	if (start >= end || vma_overlap (spt, start, end) != NULL)
+		return NULL;
+	vma = malloc (sizeof *vma);
+	if (vma == NULL)
+		return NULL;
+	vma->start = start;
+	vma->end = end;
+	vma->file = NULL;
+	vma->ofs = ofs;
+	vma->flags = flags;
+	list_init (&vma->pages);
+	if (file != NULL && (vma->file = file_reopen (file)) == NULL) {
+		free (vma);
+		return NULL;
+	}
+	spt->vmas = tree_insert (spt->vmas, vma);
+	return vma;
+}
+
+/* Removes VMA from SPT along with every page in it. */
+void
+vma_destroy (struct supplemental_page_table *spt, struct vma *vma) {
+	spt->vmas = tree_remove (spt->vmas, vma);
+	if (spt->heap == vma)
+		spt->heap = NULL;
+
+	while (!list_empty (&vma->pages)) {
+		struct page *page = list_entry (list_pop_front (&vma->pages),
+				struct page, vma_elem);
+
+		page->vma = NULL;
+		spt_remove_page (spt, page);
+	}
+	file_close (vma->file);
+	free (vma);
+}
+
+/* Moves the end of VMA to END, which must not leave it empty, and returns
+ * true.  Pages past END must be gone already.  Returns false, leaving VMA
+ * as it is, if it would overlap another area. */
+bool
+vma_resize (struct supplemental_page_table *spt, struct vma *vma,
+		void *end) {
+	ASSERT (pg_ofs (end) == 0 && end > vma->start);
+
+	if (end > vma->end && vma_overlap (spt, vma->end, end) != NULL)
+		return false;
+
+	/* The largest ends on the path to VMA change along with it. */
+	spt->vmas = tree_remove (spt->vmas, vma);
+	vma->end = end;
+	spt->vmas = tree_insert (spt->vmas, vma);
+	return true;
+}
+
+/* Returns the highest address at or above FLOOR where LENGTH bytes fit
+ * below CEILING without touching any area of SPT, or NULL if there is no
+ * such place.  Each step skips a whole area. */
+void *
+vma_find_free (struct supplemental_page_table *spt, size_t length,
+		const void *floor, const void *ceiling) {
+	uintptr_t end = (uintptr_t) ceiling;
+
+	while (end >= (uintptr_t) floor && end - (uintptr_t) floor >= length) {
+		uintptr_t start = end - length;
+		struct vma *below = vma_below (spt, (void *) end);
+
+		if (below == NULL || (uintptr_t) below->end <= start)
+			return (void *) start;
+		end = (uintptr_t) below->start;
+	}
+	return NULL;
+}
+
+/* Copies each area of SRC rooted at N into DST. */
+static bool
+copy_subtree (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src, struct vma *n) {
+	struct vma *copy;
+
+	if (n == NULL)
+		return true;
+	copy = vma_create (dst, n->start, n->end, n->file, n->ofs, n->flags);
+	if (copy == NULL)
+		return false;
+	if (src->heap == n)
+		dst->heap = copy;
+	return copy_subtree (dst, src, n->left)
+		&& copy_subtree (dst, src, n->right);
+}
+
+/* Sets up the areas of SRC, without any pages, in DST, for fork (). */
+bool
+vma_copy (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src) {
+	return copy_subtree (dst, src, src->vmas);
+}
+
+/* Removes every area of SPT, and every page in them. */
+void
+vma_kill (struct supplemental_page_table *spt) {
+	while (spt->vmas != NULL)
+		vma_destroy (spt, spt->vmas);
+}
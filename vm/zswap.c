@@ -0,0 +1,298 @@
+/* zswap.c: Compressed in-memory cache in front of the swap disk.
+ *
+ * Evicted anonymous pages are compressed with a small LZSS coder into an
+ * arena of kernel pages, carved into fixed-size chunks.  A page occupies a
+ * run of consecutive chunks.  When no run is free, the oldest cached pages
+ * are decompressed and written to the swap disk until one is.  Pages that
+ * do not compress to at most ZSWAP_MAX_SIZE bytes go straight to disk. */
+
+#include "vm/zswap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "vm/vm.h"
+
+/* Allocation unit within the arena. */
+#define ZSWAP_CHUNK 64
+
+/* Largest compressed page worth keeping in memory. */
+#define ZSWAP_MAX_SIZE (PGSIZE * 3 / 4)
+
+/* LZSS parameters: a match is a 12-bit distance and a 4-bit length. */
+#define LZ_MIN_MATCH 3
+#define LZ_MAX_MATCH (LZ_MIN_MATCH + 15)
+#define LZ_WINDOW 4096
+#define LZ_HASH_BITS 12
+
+/* A compressed page in the arena. */
+struct zswap_entry {
+	struct list_elem elem;      /* Element in entries, oldest first. */
+	struct page *page;          /* Page whose contents these are. */
+	size_t chunk;               /* First chunk in the arena. */
+	size_t size;                /* Compressed size in bytes. */
+};
+
+size_t zswap_pages;
+
+/* Statistics. */
+static uint64_t stored_cnt;     /* Pages compressed into the arena. */
+static uint64_t loaded_cnt;     /* Pages read back from the arena. */
+static uint64_t spilled_cnt;    /* Pages moved on to the swap disk. */
+static uint64_t rejected_cnt;   /* Pages that did not compress. */
+
+/* Protects everything below and the zentry of every anonymous page. */
+static struct lock zswap_lock;
+static uint8_t *arena;          /* ZSWAP_PAGES kernel pages. */
+static struct bitmap *chunks;   /* Chunks of the arena in use. */
+static struct list entries;     /* Cached pages, oldest first. */
+static uint8_t *buffer;         /* Scratch page for (de)compression. */
+static uint16_t *lz_table;      /* Match finder: 1 + last position of a
+                                   3-byte prefix, 0 if none. */
+
+/* Sets up the cache if it is enabled. */
+void
+zswap_init (void) {
+	lock_init (&zswap_lock);
+	list_init (&entries);
+	if (zswap_pages == 0)
+		return;
+
+	arena = palloc_get_multiple (0, zswap_pages);
+	chunks = bitmap_create (zswap_pages * (PGSIZE / ZSWAP_CHUNK));
+	buffer = palloc_get_page (0);
+	lz_table = malloc (sizeof *lz_table << LZ_HASH_BITS);
+	if (arena == NULL || chunks == NULL || buffer == NULL || lz_table == NULL)
+		PANIC ("cannot allocate a %zu page compressed swap cache", zswap_pages);
+}
+
+/* Hashes the three bytes at P. */
+static unsigned
+lz_hash (const uint8_t *p) {
+	uint32_t v = p[0] | p[1] << 8 | p[2] << 16;
+	return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* Compresses the SIZE bytes at SRC into DST, which has room for DST_SIZE
+ * bytes.  Returns the compressed size, or 0 if it does not fit.
+ *
+ * The output is a sequence of groups of up to eight items, each group
+ * preceded by a flag byte.  A clear flag bit stands for a literal byte, a
+ * set one for a 16-bit match: distance - 1 in the high 12 bits and
+ * length - LZ_MIN_MATCH in the low 4. */
+static size_t
+lz_compress (const uint8_t *src, size_t size, uint8_t *dst, size_t dst_size) {
+	size_t in = 0, out = 0, flags = 0;
+	int bit = 8;
+
+	ASSERT (size <= LZ_WINDOW);
+	memset (lz_table, 0, sizeof *lz_table << LZ_HASH_BITS);
+	while (in < size) {
+		size_t len = 0, dist = 0;
+
+		if (bit == 8) {
+			if (out == dst_size)
+				return 0;
+			flags = out++;
+			dst[flags] = 0;
+			bit = 0;
+		}
+
+		if (in + LZ_MIN_MATCH <= size) {
+			unsigned h = lz_hash (src + in);
+			size_t cand = lz_table[h];
+
+			lz_table[h] = in + 1;
+			if (cand-- != 0) {
+				while (len < LZ_MAX_MATCH && in + len < size
+						&& src[cand + len] == src[in + len])
+					len++;
+				dist = in - cand;
+			}
+		}
+
+		if (len >= LZ_MIN_MATCH) {
+			uint16_t code = (dist - 1) << 4 | (len - LZ_MIN_MATCH);
+
+			if (dst_size - out < 2)
+				return 0;
+			dst[flags] |= 1 << bit;
+			dst[out++] = code >> 8;
+			dst[out++] = code & 0xff;
+			in += len;
+		} else {
+			if (out == dst_size)
+				return 0;
+			dst[out++] = src[in++];
+		}
+		bit++;
+	}
+	return out;
+}
+
+/* Decompresses the SIZE bytes at SRC, produced by lz_compress (), into
+ * the DST_SIZE bytes at DST.  Returns false if SRC is malformed. */
+static bool
+lz_decompress (const uint8_t *src, size_t size, uint8_t *dst,
+		size_t dst_size) {
+	size_t in = 0, out = 0;
+
+	while (in < size) {
+		uint8_t flags = src[in++];
+		int bit;
+
+		for (bit = 0; bit < 8 && in < size; bit++) {
+			if (flags & (1 << bit)) {
+				uint16_t code;
+				size_t dist, len;
+
+				if (size - in < 2)
+					return false;
+				code = src[in] << 8 | src[in + 1];
+				in += 2;
+				dist = (code >> 4) + 1;
+				len = (code & 15) + LZ_MIN_MATCH;
+				if (dist > out || dst_size - out < len)
+					return false;
+				for (; len > 0; len--, out++)
+					dst[out] = dst[out - dist];
+			} else {
+				if (out == dst_size)
+					return false;
+				dst[out++] = src[in++];
+			}
+		}
+	}
+	return out == dst_size;
+}
+
+/* Returns the number of chunks SIZE bytes occupy. */
+static size_t
+chunk_cnt (size_t size) {
+	return DIV_ROUND_UP (size, ZSWAP_CHUNK);
+}
+
+/* Releases ENTRY's chunks and frees it. */
+static void
+free_entry (struct zswap_entry *entry) {
+	list_remove (&entry->elem);
+	bitmap_set_multiple (chunks, entry->chunk, chunk_cnt (entry->size), false);
+	entry->page->anon.zentry = NULL;
+	free (entry);
+}
+
+/* Writes the oldest cached page to the swap disk.  Returns false if there
+ * is none or the swap disk is full. */
+static bool
+spill_oldest (void) {
+	struct zswap_entry *entry;
+	size_t slot;
+
+	if (list_empty (&entries))
+		return false;
+	entry = list_entry (list_front (&entries), struct zswap_entry, elem);
+	if (!lz_decompress (arena + entry->chunk * ZSWAP_CHUNK, entry->size,
+				buffer, PGSIZE))
+		PANIC ("compressed swap cache corrupted");
+	slot = anon_swap_write (buffer);
+	if (slot == SWAP_SLOT_NONE)
+		return false;
+
+	entry->page->anon.swap_slot = slot;
+	free_entry (entry);
+	spilled_cnt++;
+	return true;
+}
+
+/* Compresses the anonymous PAGE, whose contents are at KVA, into the
+ * cache.  Returns false if the cache is disabled or cannot take it, in
+ * which case PAGE goes to the swap disk. */
+bool
+zswap_store (struct page *page, const void *kva) {
+	struct zswap_entry *entry;
+	size_t size, cnt, chunk;
+
+	if (zswap_pages == 0)
+		return false;
+	entry = malloc (sizeof *entry);
+	if (entry == NULL)
+		return false;
+
+	lock_acquire (&zswap_lock);
+	size = lz_compress (kva, PGSIZE, buffer, ZSWAP_MAX_SIZE);
+	if (size == 0) {
+		rejected_cnt++;
+		goto fail;
+	}
+
+	/* Spilling decompresses into BUFFER, so keep the result in the arena
+	 * right away if it fits, and compress again otherwise. */
+	cnt = chunk_cnt (size);
+	chunk = bitmap_scan_and_flip (chunks, 0, cnt, false);
+	if (chunk == BITMAP_ERROR) {
+		while (chunk == BITMAP_ERROR && spill_oldest ())
+			chunk = bitmap_scan_and_flip (chunks, 0, cnt, false);
+		if (chunk == BITMAP_ERROR)
+			goto fail;
+		lz_compress (kva, PGSIZE, buffer, ZSWAP_MAX_SIZE);
+	}
+	memcpy (arena + chunk * ZSWAP_CHUNK, buffer, size);
+
+	entry->page = page;
+	entry->chunk = chunk;
+	entry->size = size;
+	list_push_back (&entries, &entry->elem);
+	page->anon.zentry = entry;
+	stored_cnt++;
+	lock_release (&zswap_lock);
+	return true;
+
+fail:
+	lock_release (&zswap_lock);
+	free (entry);
+	return false;
+}
+
+/* If PAGE is in the cache, decompresses it into KVA, drops it from the
+ * cache and returns true.  Returns false otherwise. */
+bool
+zswap_load (struct page *page, void *kva) {
+	struct zswap_entry *entry;
+
+	lock_acquire (&zswap_lock);
+	entry = page->anon.zentry;
+	if (entry != NULL) {
+		if (!lz_decompress (arena + entry->chunk * ZSWAP_CHUNK, entry->size,
+					kva, PGSIZE))
+			PANIC ("compressed swap cache corrupted");
+		free_entry (entry);
+		loaded_cnt++;
+	}
+	lock_release (&zswap_lock);
+	return entry != NULL;
+}
+
+/* Drops PAGE, which is being destroyed, from the cache. */
+void
+zswap_drop (struct page *page) {
+	lock_acquire (&zswap_lock);
+	if (page->anon.zentry != NULL)
+		free_entry (page->anon.zentry);
+	lock_release (&zswap_lock);
+}
+
+/* Prints compressed swap cache statistics. */
+void
+zswap_print_stats (void) {
+	if (zswap_pages != 0)
+		printf ("Zswap: %llu pages stored, %llu loaded, %llu spilled, "
+				"%llu rejected\n",
+				stored_cnt, loaded_cnt, spilled_cnt, rejected_cnt);
+}